@@ -2,8 +2,10 @@
 
 import argparse
 import ast
+import bz2
 from enum import Enum
 import functools
+import gzip
 import json
 import os
 import re
@@ -72,12 +74,13 @@ def load_cloud_ip_ranges(cloud, region):
     raise ValueError(f'Unsupported cloud {cloud}')
 
 def load_itdk_mapping_internal(node_file, reverse=False) -> dict:
-    logging.info('Loading ITDK nodes ...')
+    node_file = find_itdk_file(node_file)
+    logging.info(f'Loading ITDK nodes from {node_file} ...')
     start_time = time.time()
     mapping_id_to_ips = {}
     mapping_ip_to_id = {}
     node_count = 0
-    with open(node_file, 'r') as file:
+    with open_itdk_file(node_file) as file:
         for line in file:
             if line.startswith('#'):
                 continue
@@ -113,6 +116,37 @@ def load_itdk_node_id_to_ips_mapping(node_file='../data/caida-itdk/midar-iff.nod
 def load_itdk_node_ip_to_id_mapping(node_file='../data/caida-itdk/midar-iff.nodes') -> dict[str, str]:
     return load_itdk_mapping_internal(node_file, True)
 
+def find_itdk_file(path: str) -> str:
+    """Return path, or its .bz2 or .gz version when only the compressed release file is present."""
+    for candidate in [path, path + '.bz2', path + '.gz']:
+        if os.path.exists(candidate):
+            return candidate
+    return path
+
+def open_itdk_file(path: str):
+    """Open an ITDK release file as text, decompressing it on the fly if it is a .bz2 or .gz file."""
+    if path.endswith('.bz2'):
+        return bz2.open(path, 'rt')
+    if path.endswith('.gz'):
+        return gzip.open(path, 'rt')
+    return open(path, 'r')
+
+def load_itdk_nodes(node_file='../data/caida-itdk/midar-iff.nodes'):
+    """Load ITDK nodes natively on all cores, in both directions: the IPs of node N123 are
+    ips[offsets[123]:offsets[124]] as uint32, and sorted_ips[i] belongs to node ip_nodes[i]. The arrays are read-only
+    numpy views of the native ones, with ips_of(node_id) and node_of(ip) for single lookups. The file can be
+    bzip2 or gzip compressed, and is decompressed while it is parsed."""
+    # Imported here, so that scripts using only the mappings above don't need the native module.
+    from graph_module import NodeIPs
+
+    node_file = find_itdk_file(node_file)
+    logging.info(f'Loading ITDK nodes from {node_file} ...')
+    start_time = time.time()
+    nodes = NodeIPs.load(node_file)
+    elapsed_time = time.time() - start_time
+    logging.info(f'Elapsed: {elapsed_time:.2f}s, total IP count: {nodes.ip_count()}')
+    return nodes
+
 def get_routes_from_file(filename) -> list[list]:
     logging.info(f'Loading routes from {filename} ...')
     with open(filename, 'r') as file:
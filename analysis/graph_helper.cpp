@@ -1,101 +1,3799 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <queue>
 #include <set>
+#include <map>
 #include <string>
 #include <tuple>
 #include <sstream>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <atomic>
+#include <limits>
+#include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <typeindex>
 #include <omp.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <bzlib.h>
 
 namespace py = pybind11;
 
-class Graph {
+// Bitmask over the sources of one multi-source BFS batch, W * 64 sources wide. The fixed-size word loops
+//  compile down to SIMD OR/ANDNOT.
+template <size_t W>
+struct SourceMask {
+    uint64_t words[W];
+
+    void clear() {
+        for (size_t i = 0; i < W; ++i) {
+            words[i] = 0;
+        }
+    }
+
+    bool any() const {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < W; ++i) {
+            bits |= words[i];
+        }
+        return bits != 0;
+    }
+
+    bool test(const size_t &bit) const {
+        return (words[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    void set(const size_t &bit) {
+        words[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+
+    void reset(const size_t &bit) {
+        words[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+    }
+
+    SourceMask &operator|=(const SourceMask &other) {
+        for (size_t i = 0; i < W; ++i) {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    // Returns this & ~other.
+    SourceMask and_not(const SourceMask &other) const {
+        SourceMask result;
+        for (size_t i = 0; i < W; ++i) {
+            result.words[i] = words[i] & ~other.words[i];
+        }
+        return result;
+    }
+
+    SourceMask operator&(const SourceMask &other) const {
+        SourceMask result;
+        for (size_t i = 0; i < W; ++i) {
+            result.words[i] = words[i] & other.words[i];
+        }
+        return result;
+    }
+};
+
+// Immutable array of a frozen graph, which either owns its elements or views memory owned elsewhere, such as a
+//  memory-mapped snapshot file.
+template <typename T>
+class FrozenArray {
 public:
-    std::unordered_map<unsigned int, std::unordered_set<unsigned int>> graph;
+    FrozenArray() : elements(nullptr), count(0) {}
+
+    explicit FrozenArray(std::vector<T> &&values) : owned(std::move(values)), elements(owned.data()), count(owned.size()) {}
+
+    FrozenArray(const T *data, const size_t size) : elements(data), count(size) {}
+
+    // Moving a vector keeps its buffer, so the element pointer stays valid.
+    FrozenArray(FrozenArray &&other) : owned(std::move(other.owned)), elements(other.elements), count(other.count) {}
+
+    FrozenArray &operator=(FrozenArray &&other) {
+        owned = std::move(other.owned);
+        elements = other.elements;
+        count = other.count;
+        return *this;
+    }
+
+    FrozenArray(const FrozenArray &) = delete;
+    FrozenArray &operator=(const FrozenArray &) = delete;
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    const T &operator[](const size_t &i) const {
+        return elements[i];
+    }
+
+    const T &back() const {
+        return elements[count - 1];
+    }
+
+    const T *data() const {
+        return elements;
+    }
+
+    // A non-owning array over the same elements, valid for as long as this one is.
+    FrozenArray view() const {
+        return FrozenArray(elements, count);
+    }
+
+    const T *begin() const {
+        return elements;
+    }
+
+    const T *end() const {
+        return elements + count;
+    }
+
+private:
+    std::vector<T> owned;
+    const T *elements;
+    size_t count;
+};
+
+// A file mapped into memory for as long as the object lives: an existing file read-only, or with create_size, a new
+//  file of at least that many bytes mapped writable. The size is rounded up to the block size of the file system,
+//  which a hugetlbfs mount requires, and pages written through the mapping need no write() support from it.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path, const size_t create_size = 0) : address(MAP_FAILED), length(0) {
+        const int fd = create_size > 0 ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        struct stat status;
+        if (fstat(fd, &status) == 0) {
+            if (create_size > 0) {
+                const size_t block = status.st_blksize > 0 ? status.st_blksize : 1;
+                length = (create_size + block - 1) / block * block;
+                // Reserve the blocks up front, so that a full file system fails here instead of faulting on write.
+                if (posix_fallocate(fd, 0, length) == 0) {
+                    address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                }
+            } else if (status.st_size > 0) {
+                length = status.st_size;
+                address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            } else {
+                address = nullptr;
+            }
+        }
+        close(fd);
+        if (address == MAP_FAILED) {
+            throw std::runtime_error("Cannot map " + path);
+        }
+    }
+
+    ~MappedFile() {
+        if (length > 0) {
+            munmap(address, length);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const {
+        return static_cast<const char *>(address);
+    }
+
+    // Only valid for a file mapped with create_size.
+    char *mutable_data() {
+        return static_cast<char *>(address);
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    void *address;
+    size_t length;
+};
+
+// Parses a Linux CPU or node list such as "0-3,8-11" into its numbers.
+static std::vector<int> parse_id_list(const std::string &list) {
+    std::vector<int> ids;
+    std::istringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty()) {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int id = first; id <= last; ++id) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+// The CPUs of each online NUMA node that has any, from sysfs. Empty if the topology is not available.
+static std::vector<std::vector<int>> numa_node_cpus() {
+    std::vector<std::vector<int>> node_cpus;
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string nodes;
+    if (!std::getline(online, nodes)) {
+        return node_cpus;
+    }
+    for (const int node : parse_id_list(nodes)) {
+        std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string cpus;
+        if (std::getline(cpulist, cpus) && !parse_id_list(cpus).empty()) {
+            node_cpus.push_back(parse_id_list(cpus));
+        }
+    }
+    return node_cpus;
+}
+
+// Pins the calling thread to a set of CPUs for as long as the object lives, then restores its previous affinity.
+class CpuPin {
+public:
+    explicit CpuPin(const std::vector<int> &cpus) : pinned(false) {
+        if (sched_getaffinity(0, sizeof(previous), &previous) != 0) {
+            return;
+        }
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (const int cpu : cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &mask);
+            }
+        }
+        pinned = sched_setaffinity(0, sizeof(mask), &mask) == 0;
+    }
+
+    ~CpuPin() {
+        if (pinned) {
+            sched_setaffinity(0, sizeof(previous), &previous);
+        }
+    }
+
+    CpuPin(const CpuPin &) = delete;
+    CpuPin &operator=(const CpuPin &) = delete;
+
+private:
+    cpu_set_t previous;
+    bool pinned;
+};
+
+// Cursor over the range of work items queued for one NUMA node, on a cache line of its own.
+struct WorkQueue {
+    std::atomic<size_t> next;
+    size_t end;
+    char padding[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
+
+// Parses the dotted-quad IPv4 address in [begin, end) into host order. Returns false if it is not one.
+static bool parse_ipv4(const char *begin, const char *end, unsigned int &ip) {
+    ip = 0;
+    for (int octet = 0; octet < 4; ++octet) {
+        if (octet > 0) {
+            if (begin == end || *begin != '.') {
+                return false;
+            }
+            ++begin;
+        }
+        unsigned int value = 0;
+        const char *digits = begin;
+        while (begin != end && *begin >= '0' && *begin <= '9' && begin - digits < 3) {
+            value = value * 10 + (*begin++ - '0');
+        }
+        if (begin == digits || value > 255) {
+            return false;
+        }
+        ip = ip << 8 | value;
+    }
+    return begin == end;
+}
+
+// Parses an ITDK node ID such as N123 in [begin, end) into its number. Returns false if it is not one.
+static bool parse_node_id(const char *begin, const char *end, size_t &node) {
+    if (end - begin < 2 || *begin != 'N') {
+        return false;
+    }
+    node = 0;
+    for (const char *p = begin + 1; p != end; ++p) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        node = node * 10 + (*p - '0');
+    }
+    return true;
+}
+
+// Splits [data, data + size) into about count pieces that end at line boundaries, returned as their start offsets
+//  followed by size.
+static std::vector<size_t> line_chunks(const char *data, const size_t size, const size_t count) {
+    std::vector<size_t> bounds(1, 0);
+    for (size_t c = 1; c < count; ++c) {
+        size_t position = std::max(size * c / count, bounds.back());
+        const void *newline = position < size ? std::memchr(data + position, '\n', size - position) : nullptr;
+        position = newline ? static_cast<const char *>(newline) - data + 1 : size;
+        if (position > bounds.back() && position < size) {
+            bounds.push_back(position);
+        }
+    }
+    bounds.push_back(size);
+    return bounds;
+}
+
+// A queue of at most capacity items from one producer to any number of consumers.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(const size_t capacity) : capacity(capacity), closed(false) {}
+
+    // Moves item into the queue unless it is full, and returns whether it did.
+    bool try_push(T &item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.size() >= capacity) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Takes the next item, waiting for one until the queue is closed. Returns false once it is closed and empty.
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this]() { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+};
+
+// Partial lines at the two ends of a piece of text: the text before its first newline and after its last, or all of
+//  it in head if it has none.
+struct LineFragments {
+    bool decoded = true;
+    bool has_newline = false;
+    std::string head;
+    std::string tail;
+};
+
+// Calls parse(begin, end, result) on the whole lines of text, and keeps the partial lines at its ends in fragments.
+template <typename Result, typename Parse>
+void parse_whole_lines(const std::string &text, LineFragments &fragments, Result &result, Parse &parse) {
+    const size_t first = text.find('\n');
+    fragments.has_newline = first != std::string::npos;
+    if (!fragments.has_newline) {
+        fragments.head = text;
+        return;
+    }
+    const size_t last = text.rfind('\n');
+    fragments.head = text.substr(0, first);
+    fragments.tail = text.substr(last + 1);
+    parse(text.data() + first + 1, text.data() + last + 1, result);
+}
+
+// Reads count bits from data starting at bit offset bit, most significant first as in bzip2.
+static uint64_t read_bits(const char *data, const uint64_t bit, const int count) {
+    uint64_t value = 0;
+    for (int i = 0; i < count; ++i) {
+        const uint64_t position = bit + i;
+        value = value << 1 | ((static_cast<unsigned char>(data[position / 8]) >> (7 - position % 8)) & 1);
+    }
+    return value;
+}
+
+static const uint64_t BZIP2_BLOCK_MAGIC = 0x314159265359ULL;
+static const uint64_t BZIP2_END_MAGIC = 0x177245385090ULL;
+
+// Bit offsets of the bzip2 block and end-of-stream magics in data, which are not byte-aligned, found on all cores.
+//  Each is paired with whether it starts a block.
+static std::vector<std::pair<uint64_t, bool>> bzip2_markers(const char *data, const size_t size) {
+    const size_t slices = omp_get_max_threads();
+    std::vector<std::vector<std::pair<uint64_t, bool>>> found(slices);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t s = 0; s < slices; ++s) {
+        const uint64_t first_bit = 8 * static_cast<uint64_t>(size * s / slices);
+        const uint64_t end_bit = 8 * static_cast<uint64_t>(size * (s + 1) / slices);
+        // window holds the last bits read, up to the end of byte i.
+        uint64_t window = 0;
+        for (size_t i = first_bit >= 56 ? first_bit / 8 - 7 : 0; i < size && 8 * i < end_bit + 48; ++i) {
+            window = window << 8 | static_cast<unsigned char>(data[i]);
+            for (int shift = 7; shift >= 0; --shift) {
+                const uint64_t pattern = (window >> shift) & 0xffffffffffffULL;
+                if (8 * (i + 1) < 48 + static_cast<uint64_t>(shift)) {
+                    continue;
+                }
+                const uint64_t start = 8 * (i + 1) - shift - 48;
+                if (start >= first_bit && start < end_bit && (pattern == BZIP2_BLOCK_MAGIC || pattern == BZIP2_END_MAGIC)) {
+                    found[s].push_back(std::make_pair(start, pattern == BZIP2_BLOCK_MAGIC));
+                }
+            }
+        }
+    }
+    std::vector<std::pair<uint64_t, bool>> markers;
+    for (const auto &slice : found) {
+        markers.insert(markers.end(), slice.begin(), slice.end());
+    }
+    return markers;
+}
+
+// Decodes the bzip2 block at bits [begin, end) of data into text, as a stream of its own: a header, the block, and
+//  an end-of-stream marker carrying the block's CRC, which follows its magic, as the CRC of the whole stream.
+//  Returns false if it does not decode.
+static bool bzip2_decode_block(const char *data, const uint64_t begin, const uint64_t end, std::string &text) {
+    std::string stream("BZh9");
+    uint64_t bits = 0;
+    int bit_count = 0;
+    auto put = [&](const uint64_t value, const int count) {
+        for (int i = count - 1; i >= 0; --i) {
+            bits = bits << 1 | ((value >> i) & 1);
+            if (++bit_count == 8) {
+                stream.push_back(static_cast<char>(bits));
+                bits = 0;
+                bit_count = 0;
+            }
+        }
+    };
+    // The header is whole bytes, so the block is shifted into place a byte at a time.
+    const int shift = begin % 8;
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data) + begin / 8;
+    const uint64_t whole_bytes = (end - begin) / 8;
+    stream.resize(4 + whole_bytes);
+    for (uint64_t i = 0; i < whole_bytes; ++i) {
+        stream[4 + i] = static_cast<char>(shift ? bytes[i] << shift | bytes[i + 1] >> (8 - shift) : bytes[i]);
+    }
+    stream.reserve(stream.size() + 16);
+    put(read_bits(data, begin + 8 * whole_bytes, (end - begin) % 8), (end - begin) % 8);
+    put(BZIP2_END_MAGIC, 48);
+    put(read_bits(data, begin + 48, 32), 32);
+    if (bit_count > 0) {
+        put(0, 8 - bit_count);
+    }
+
+    bz_stream decoder = bz_stream();
+    if (BZ2_bzDecompressInit(&decoder, 0, 0) != BZ_OK) {
+        return false;
+    }
+    decoder.next_in = &stream[0];
+    decoder.avail_in = stream.size();
+    text.clear();
+    int status = BZ_OK;
+    while (status == BZ_OK) {
+        const size_t used = text.size();
+        text.resize(used + std::max<size_t>(4 * stream.size(), 1 << 20));
+        decoder.next_out = &text[used];
+        decoder.avail_out = text.size() - used;
+        status = BZ2_bzDecompress(&decoder);
+        const bool stalled = status == BZ_OK && decoder.avail_out > 0;
+        text.resize(text.size() - decoder.avail_out);
+        if (stalled) {
+            break;
+        }
+    }
+    BZ2_bzDecompressEnd(&decoder);
+    return status == BZ_STREAM_END;
+}
+
+// parse_lines() for a bzip2 file, which is made of blocks that decode independently: every block is decoded and
+//  its whole lines parsed on its own core, and the lines split across blocks are put together and parsed last.
+template <typename Result, typename Parse>
+std::vector<Result> parse_bzip2_lines(const MappedFile &file, const std::string &path, Parse &parse) {
+    const std::vector<std::pair<uint64_t, bool>> markers = bzip2_markers(file.data(), file.size());
+    std::vector<size_t> blocks;
+    for (size_t m = 0; m < markers.size(); ++m) {
+        if (markers[m].second) {
+            if (m + 1 == markers.size()) {
+                throw std::runtime_error("Truncated bzip2 file: " + path);
+            }
+            blocks.push_back(m);
+        }
+    }
+
+    std::vector<LineFragments> fragments(blocks.size());
+    std::vector<Result> results(blocks.size() + 1);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        std::string text;
+        fragments[b].decoded = bzip2_decode_block(file.data(), markers[blocks[b]].first, markers[blocks[b] + 1].first, text);
+        if (fragments[b].decoded) {
+            parse_whole_lines(text, fragments[b], results[b], parse);
+        }
+    }
+
+    // A magic can also occur by chance inside compressed data, and splits its block into parts that fail to decode.
+    //  Such a run of failed blocks is decoded again as one, up to one of the next few markers.
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        if (fragments[b].decoded) {
+            continue;
+        }
+        size_t e = b;
+        while (e + 1 < blocks.size() && !fragments[e + 1].decoded) {
+            ++e;
+        }
+        std::string text;
+        bool decoded = false;
+        for (size_t m = blocks[e] + 1; m < markers.size() && m <= blocks[e] + 4 && !decoded; ++m) {
+            decoded = bzip2_decode_block(file.data(), markers[blocks[b]].first, markers[m].first, text);
+        }
+        if (!decoded) {
+            throw std::runtime_error("Corrupt bzip2 block in " + path);
+        }
+        for (size_t k = b; k <= e; ++k) {
+            fragments[k] = LineFragments();
+        }
+        parse_whole_lines(text, fragments[b], results[b], parse);
+        b = e;
+    }
+
+    std::string lines;
+    std::string line;
+    for (const auto &block : fragments) {
+        line += block.head;
+        if (block.has_newline) {
+            lines += line + '\n';
+            line = block.tail;
+        }
+    }
+    lines += line;
+    parse(lines.data(), lines.data() + lines.size(), results.back());
+    return results;
+}
+
+// parse_lines() for a gzip file, which can only be inflated in order: one thread inflates it and hands pieces of
+//  whole lines to the others through a bounded queue, and parses a piece itself whenever the queue is full.
+template <typename Result, typename Parse>
+std::vector<Result> parse_gzip_lines(const MappedFile &file, const std::string &path, Parse &parse) {
+    const size_t piece_bytes = 4 << 20;
+    BoundedQueue<std::string> queue(4 * omp_get_max_threads());
+    std::vector<Result> results;
+    std::mutex results_mutex;
+    std::string error;
+    auto parse_piece = [&](const std::string &piece) {
+        Result result;
+        parse(piece.data(), piece.data() + piece.size(), result);
+        std::lock_guard<std::mutex> lock(results_mutex);
+        results.push_back(std::move(result));
+    };
+
+    #pragma omp parallel
+    {
+        if (omp_get_thread_num() == 0) {
+            // Exceptions cannot leave the parallel region, and the queue must be closed for the other threads.
+            try {
+                z_stream stream = z_stream();
+                if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+                    throw std::runtime_error("Cannot inflate " + path);
+                }
+                size_t consumed = 0;
+                std::string piece;
+                std::vector<char> buffer(piece_bytes);
+                bool done = file.size() == 0;
+                while (!done) {
+                    if (stream.avail_in == 0) {
+                        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(file.data() + consumed));
+                        stream.avail_in = std::min<size_t>(file.size() - consumed, 1 << 30);
+                        consumed += stream.avail_in;
+                    }
+                    stream.next_out = reinterpret_cast<Bytef *>(buffer.data());
+                    stream.avail_out = buffer.size();
+                    const int status = inflate(&stream, Z_NO_FLUSH);
+                    piece.append(buffer.data(), buffer.size() - stream.avail_out);
+                    if (status == Z_STREAM_END) {
+                        // Concatenated gzip members continue the same text.
+                        done = stream.avail_in == 0 && consumed == file.size();
+                        if (!done) {
+                            inflateReset(&stream);
+                        }
+                    } else if (status != Z_OK && !(status == Z_BUF_ERROR && stream.avail_in == 0 && consumed < file.size())) {
+                        inflateEnd(&stream);
+                        throw std::runtime_error("Corrupt or truncated gzip file: " + path);
+                    }
+                    const size_t last = piece.rfind('\n');
+                    if ((piece.size() >= piece_bytes || done) && last != std::string::npos) {
+                        std::string rest = piece.substr(last + 1);
+                        piece.resize(last + 1);
+                        if (!queue.try_push(piece)) {
+                            parse_piece(piece);
+                        }
+                        piece.swap(rest);
+                    }
+                }
+                inflateEnd(&stream);
+                parse_piece(piece);
+            } catch (const std::exception &e) {
+                error = e.what();
+            }
+            queue.close();
+        }
+        std::string piece;
+        while (queue.pop(piece)) {
+            parse_piece(piece);
+        }
+    }
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+    return results;
+}
+
+// Calls parse(begin, end, result) with a fresh Result on pieces of whole lines of a text file, on all cores, and
+//  returns the results in no particular order. A plain file is mapped and split at line boundaries, and a gzip or
+//  bzip2 file, recognized by its magic bytes, is decompressed on the fly without temporary files.
+template <typename Result, typename Parse>
+std::vector<Result> parse_lines(const std::string &path, Parse parse) {
+    const MappedFile file(path);
+    const unsigned char *magic = reinterpret_cast<const unsigned char *>(file.data());
+    if (file.size() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        return parse_gzip_lines<Result>(file, path, parse);
+    }
+    if (file.size() >= 4 && std::memcmp(magic, "BZh", 3) == 0 && magic[3] >= '1' && magic[3] <= '9') {
+        return parse_bzip2_lines<Result>(file, path, parse);
+    }
+    const std::vector<size_t> bounds = line_chunks(file.data(), file.size(), 16 * omp_get_max_threads());
+    std::vector<Result> results(bounds.size() - 1);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t c = 0; c < results.size(); ++c) {
+        parse(file.data() + bounds[c], file.data() + bounds[c + 1], results[c]);
+    }
+    return results;
+}
+
+// Sorts values on all cores: each thread sorts one slice, and the slices are then merged pairwise.
+static void parallel_sort(std::vector<uint64_t> &values) {
+    const size_t slices = omp_get_max_threads();
+    std::vector<size_t> bounds(slices + 1);
+    for (size_t i = 0; i <= slices; ++i) {
+        bounds[i] = values.size() * i / slices;
+    }
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < slices; ++i) {
+        std::sort(values.begin() + bounds[i], values.begin() + bounds[i + 1]);
+    }
+    for (size_t width = 1; width < slices; width *= 2) {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t i = 0; i < slices; i += 2 * width) {
+            if (i + width < slices) {
+                std::inplace_merge(values.begin() + bounds[i], values.begin() + bounds[i + width], values.begin() + bounds[std::min(i + 2 * width, slices)]);
+            }
+        }
+    }
+}
+
+// The IPs of the ITDK nodes (midar-iff.nodes) in CSR form, indexed by the number of the node ID (node N123 is 123):
+//  the IPs of node n are ips[offsets[n]] ... ips[offsets[n + 1] - 1], as unsigned ints in host order like the
+//  graph's vertices. For the other direction, sorted_ips holds every IP in ascending order and ip_nodes the node
+//  of each.
+struct NodeIPs {
+    std::vector<size_t> offsets;
+    std::vector<unsigned int> ips;
+    std::vector<unsigned int> sorted_ips;
+    std::vector<unsigned int> ip_nodes;
+
+    // Parses a nodes file, "node N<id>:  <ip> <ip> ...", on all cores, plain or compressed as in parse_lines().
+    static NodeIPs load(const std::string &node_file) {
+        // Each piece collects its nodes with their IP counts, and their IPs in the same order.
+        struct Piece {
+            std::vector<std::pair<size_t, size_t>> nodes;
+            std::vector<unsigned int> ips;
+        };
+        std::vector<Piece> pieces = parse_lines<Piece>(node_file, [](const char *line, const char *end, Piece &piece) {
+            static const char prefix[] = "node ";
+            while (line < end) {
+                const void *newline = std::memchr(line, '\n', end - line);
+                const char *line_end = newline ? static_cast<const char *>(newline) : end;
+                const char *colon = static_cast<const char *>(std::memchr(line, ':', line_end - line));
+                size_t node;
+                if (line == line_end || *line == '#') {
+                    // Comment or blank line
+                } else if (!colon || line_end - line < static_cast<ptrdiff_t>(sizeof(prefix) - 1) || std::memcmp(line, prefix, sizeof(prefix) - 1) != 0
+                           || !parse_node_id(line + sizeof(prefix) - 1, colon, node)) {
+                    std::cerr << "Cannot process line: " + std::string(line, line_end) + "\n";
+                } else {
+                    const size_t first_ip = piece.ips.size();
+                    const char *p = colon + 1;
+                    while (p < line_end) {
+                        while (p < line_end && std::isspace(static_cast<unsigned char>(*p))) {
+                            ++p;
+                        }
+                        const char *word = p;
+                        while (p < line_end && !std::isspace(static_cast<unsigned char>(*p))) {
+                            ++p;
+                        }
+                        unsigned int ip;
+                        if (p != word && parse_ipv4(word, p, ip)) {
+                            piece.ips.push_back(ip);
+                        } else if (p != word) {
+                            std::cerr << "Cannot process IP: " + std::string(word, p) + "\n";
+                        }
+                    }
+                    piece.nodes.push_back(std::make_pair(node, piece.ips.size() - first_ip));
+                }
+                line = line_end + 1;
+            }
+        });
+
+        size_t node_count = 0;
+        for (const auto &piece : pieces) {
+            for (const auto &node : piece.nodes) {
+                node_count = std::max(node_count, node.first + 1);
+            }
+        }
+        NodeIPs result;
+        result.offsets.assign(node_count + 1, 0);
+        for (const auto &piece : pieces) {
+            for (const auto &node : piece.nodes) {
+                if (result.offsets[node.first + 1] != 0) {
+                    throw std::runtime_error("Duplicate node N" + std::to_string(node.first) + " in " + node_file);
+                }
+                result.offsets[node.first + 1] = node.second;
+            }
+        }
+        for (size_t n = 0; n < node_count; ++n) {
+            result.offsets[n + 1] += result.offsets[n];
+        }
+        result.ips.resize(result.offsets.back());
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t c = 0; c < pieces.size(); ++c) {
+            auto ip = pieces[c].ips.begin();
+            for (const auto &node : pieces[c].nodes) {
+                std::copy(ip, ip + node.second, result.ips.begin() + result.offsets[node.first]);
+                ip += node.second;
+            }
+            std::vector<unsigned int>().swap(pieces[c].ips);
+        }
+        result.build_ip_index();
+        return result;
+    }
+
+    // The same nodes restricted to node_ids, such as "N123"; the IPs of all other nodes are dropped.
+    NodeIPs keep_nodes(const std::vector<std::string> &node_ids) const {
+        std::vector<char> keep(node_count(), 0);
+        for (const auto &node_id : node_ids) {
+            size_t node;
+            if (parse_node_id(node_id.data(), node_id.data() + node_id.size(), node) && node < keep.size()) {
+                keep[node] = 1;
+            }
+        }
+        NodeIPs result;
+        result.offsets.assign(offsets.size(), 0);
+        for (size_t n = 0; n < node_count(); ++n) {
+            result.offsets[n + 1] = result.offsets[n] + (keep[n] ? offsets[n + 1] - offsets[n] : 0);
+        }
+        result.ips.resize(result.offsets.back());
+        #pragma omp parallel for schedule(dynamic, 4096)
+        for (size_t n = 0; n < node_count(); ++n) {
+            if (keep[n]) {
+                std::copy(ips.begin() + offsets[n], ips.begin() + offsets[n + 1], result.ips.begin() + result.offsets[n]);
+            }
+        }
+        result.build_ip_index();
+        return result;
+    }
+
+    size_t node_count() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    size_t ip_count() const {
+        return ips.size();
+    }
+
+    std::vector<unsigned int> ips_of(const std::string &node_id) const {
+        size_t node;
+        if (!parse_node_id(node_id.data(), node_id.data() + node_id.size(), node) || node >= node_count()) {
+            return std::vector<unsigned int>();
+        }
+        return std::vector<unsigned int>(ips.begin() + offsets[node], ips.begin() + offsets[node + 1]);
+    }
+
+    // Returns the ID of the node with the given IP, such as "N123", or an empty string if there is none.
+    std::string node_of(const unsigned int &ip) const {
+        auto it = std::lower_bound(sorted_ips.begin(), sorted_ips.end(), ip);
+        if (it == sorted_ips.end() || *it != ip) {
+            return std::string();
+        }
+        return "N" + std::to_string(ip_nodes[it - sorted_ips.begin()]);
+    }
+
+    // Returns the distinct numbers of the nodes of the given IPs, the vertices of a node-level graph, in ascending
+    //  order. IPs of no node are skipped.
+    std::vector<unsigned int> nodes_of(const std::vector<unsigned int> &node_ips) const {
+        std::vector<unsigned int> nodes;
+        for (const auto &ip : node_ips) {
+            auto it = std::lower_bound(sorted_ips.begin(), sorted_ips.end(), ip);
+            if (it != sorted_ips.end() && *it == ip) {
+                nodes.push_back(ip_nodes[it - sorted_ips.begin()]);
+            }
+        }
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        return nodes;
+    }
+
+    // Returns the first IP of each of the given node numbers, e.g. to print a path of a node-level graph as IPs, or
+    //  0 for a node without IPs.
+    std::vector<unsigned int> first_ips(const std::vector<unsigned int> &nodes) const {
+        std::vector<unsigned int> result(nodes.size(), 0);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (nodes[i] < node_count() && offsets[nodes[i]] < offsets[nodes[i] + 1]) {
+                result[i] = ips[offsets[nodes[i]]];
+            }
+        }
+        return result;
+    }
+
+private:
+    void build_ip_index() {
+        std::vector<uint64_t> entries(ips.size());
+        #pragma omp parallel for schedule(dynamic, 4096)
+        for (size_t n = 0; n < node_count(); ++n) {
+            for (size_t j = offsets[n]; j < offsets[n + 1]; ++j) {
+                entries[j] = static_cast<uint64_t>(ips[j]) << 32 | n;
+            }
+        }
+        parallel_sort(entries);
+        sorted_ips.resize(entries.size());
+        ip_nodes.resize(entries.size());
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < entries.size(); ++i) {
+            sorted_ips[i] = entries[i] >> 32;
+            ip_nodes[i] = static_cast<unsigned int>(entries[i]);
+        }
+    }
+};
+
+// A read-only numpy array over values, which keeps owner alive for as long as the array is referenced.
+template <typename T>
+py::array_t<T> numpy_view(const std::vector<T> &values, const py::object &owner) {
+    py::array_t<T> array(static_cast<ssize_t>(values.size()), values.data(), owner);
+    array.attr("setflags")(py::arg("write") = false);
+    return array;
+}
+
+// Layout of a graph snapshot file: this header, then each non-empty section at the offset recorded here, aligned
+//  to SNAPSHOT_ALIGNMENT bytes so that the arrays can be used in place from a read-only mapping. The checksum
+//  covers the header, with its checksum field zeroed, and every byte from there to the end of the last section.
+enum SnapshotSection {
+    SECTION_VERTEX_IPS,
+    SECTION_OFFSETS,
+    SECTION_NEIGHBORS,
+    SECTION_POSITIONS,
+    SECTION_WEIGHTS,
+    SECTION_HIERARCHY_RANK,
+    SECTION_HIERARCHY_OFFSETS,
+    SECTION_HIERARCHY_EDGES,
+    SECTION_ORACLE_OFFSETS,
+    SECTION_ORACLE_LANDMARKS,
+    SECTION_ORACLE_DISTANCES,
+    SECTION_COUNT
+};
+
+struct SnapshotHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t distance_bytes;
+    uint32_t node_level;
+    uint32_t reserved;
+    uint64_t checksum;
+    uint64_t section_offsets[SECTION_COUNT];
+    uint64_t section_bytes[SECTION_COUNT];
+};
+
+// Set of vertex indices, stored as a bitmap.
+class VertexSet {
+public:
+    explicit VertexSet(const size_t vertex_count = 0) : words((vertex_count + 63) / 64, 0) {}
+
+    void insert(const unsigned int &vertex) {
+        words[vertex / 64] |= uint64_t(1) << (vertex % 64);
+    }
+
+    bool operator[](const unsigned int &vertex) const {
+        return (words[vertex / 64] >> (vertex % 64)) & 1;
+    }
+
+private:
+    std::vector<uint64_t> words;
+};
+
+// A set of endpoint IPs, resolved once to graph vertices so that searches never look up IPs.
+struct Endpoints {
+    std::set<unsigned int> ips;
+    // Indices of the IPs present in the graph, ascending, and the same as a bitmap.
+    std::vector<unsigned int> indices;
+    VertexSet vertices;
+
+    bool has_ip(const unsigned int &ip) const {
+        return ips.find(ip) != ips.end();
+    }
+};
+
+// Several labelled endpoint sets, e.g. the IPs of each destination region, for searches that find the nearest
+//  endpoint of every label at once.
+struct LabelledEndpoints {
+    std::vector<std::string> labels;
+    std::vector<Endpoints> endpoints;
+    // (vertex index, label index) of every labelled vertex, sorted, and the union of all labelled vertices.
+    std::vector<std::pair<unsigned int, unsigned int>> vertex_labels;
+    VertexSet vertices;
+};
+
+// Per-thread state of the multi-source BFS, reused across batches. Both arrays are all-zero between batches, and
+//  each batch clears only the vertices it reached.
+template <size_t W>
+struct MultiSourceWorkspace {
+    std::vector<SourceMask<W>> seen;
+    std::vector<SourceMask<W>> next;
+
+    explicit MultiSourceWorkspace(const size_t vertex_count) : seen(vertex_count), next(vertex_count) {}
+};
+
+// Hop counts are stored as signed integers of GRAPH_DISTANCE_BITS bits (8, 16 or 32), chosen at build time to
+//  trade per-thread memory against the longest path a distance-keeping search can follow.
+#ifndef GRAPH_DISTANCE_BITS
+#define GRAPH_DISTANCE_BITS 16
+#endif
+
+template <int Bits>
+struct DistanceType {
+    static_assert(Bits == 8 || Bits == 16 || Bits == 32, "GRAPH_DISTANCE_BITS must be 8, 16 or 32");
+};
+
+template <>
+struct DistanceType<8> {
+    typedef int8_t type;
+};
+
+template <>
+struct DistanceType<16> {
+    typedef int16_t type;
+};
+
+template <>
+struct DistanceType<32> {
+    typedef int32_t type;
+};
+
+typedef DistanceType<GRAPH_DISTANCE_BITS>::type Distance;
+
+// Per-thread search state that persists across queries. prev and distance are only valid for vertices whose stamp
+//  equals the current epoch, so reset() starts the next search in O(1) instead of clearing arrays of size V.
+struct SearchWorkspace {
+    typedef std::tuple<Distance, unsigned int> HeapEntry;
+
+    std::vector<uint32_t> stamp;
+    std::vector<unsigned int> prev;
+    std::vector<Distance> distance;
+    uint32_t epoch;
+
+    // Scratch buffers, kept to reuse their capacity. frontier_bitmap is all-zero between levels.
+    std::vector<unsigned int> frontier;
+    std::vector<unsigned int> next_frontier;
+    std::vector<uint64_t> frontier_bitmap;
+    std::vector<HeapEntry> heap;
+
+    explicit SearchWorkspace(const size_t vertex_count)
+        : stamp(vertex_count, 0), prev(vertex_count), distance(vertex_count), epoch(0), frontier_bitmap((vertex_count + 63) / 64, 0) {}
+
+    void reset() {
+        if (++epoch == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+        frontier.clear();
+        next_frontier.clear();
+        heap.clear();
+    }
+
+    bool visited(const unsigned int &vertex) const {
+        return stamp[vertex] == epoch;
+    }
+
+    void visit(const unsigned int &vertex, const unsigned int &parent) {
+        stamp[vertex] = epoch;
+        prev[vertex] = parent;
+    }
+};
+
+// One workspace for each side of a bidirectional search.
+struct BidirectionalWorkspace {
+    SearchWorkspace forward;
+    SearchWorkspace backward;
+
+    explicit BidirectionalWorkspace(const size_t vertex_count) : forward(vertex_count), backward(vertex_count) {}
+};
+
+// Search state plus the per-vertex path counts of the shortest-path DAG.
+struct ECMPWorkspace {
+    SearchWorkspace search;
+    // Vertices in BFS order, and the number of shortest paths from the source to, and from each to a destination.
+    std::vector<unsigned int> order;
+    std::vector<double> paths_from_source;
+    std::vector<double> paths_to_destination;
+
+    explicit ECMPWorkspace(const size_t vertex_count) : search(vertex_count), paths_from_source(vertex_count), paths_to_destination(vertex_count) {}
+};
+
+// Search state of A*: per vertex, the km travelled from the source and the estimated km left to a destination.
+struct AStarWorkspace {
+    typedef std::pair<double, unsigned int> HeapEntry;
+
+    SearchWorkspace search;
+    std::vector<double> cost;
+    std::vector<double> estimate;
+    std::vector<HeapEntry> heap;
+
+    explicit AStarWorkspace(const size_t vertex_count) : search(vertex_count), cost(vertex_count), estimate(vertex_count) {}
+};
+
+// Edge of a contraction hierarchy, stored at its lower-ranked end: to a higher-ranked vertex, in km, and the
+//  vertex the shortcut bypasses (NO_VERTEX for an edge of the graph).
+struct ShortcutEdge {
+    unsigned int target;
+    unsigned int middle;
+    double weight;
+};
+
+// Settled vertices of an upward search from a set of destinations, with their km and parent toward a destination.
+typedef std::unordered_map<unsigned int, std::pair<double, unsigned int>> UpwardSearchSpace;
+
+// All shortest paths from one source to its nearest destinations. path_count is a double since it can grow
+//  exponentially with the hop count; vertex_fractions maps each IP on the DAG to the share of paths through it.
+struct ECMPPaths {
+    int hops;
+    double path_count;
+    std::map<unsigned int, double> vertex_fractions;
+    std::vector<std::vector<unsigned int>> paths;
+
+    ECMPPaths() : hops(-1), path_count(0) {}
+};
+
+// Search workspaces kept between queries, so that each query takes already allocated state instead of zero-filling
+//  O(V) arrays again; the epoch stamps make reusing them O(1). Workspaces are checked out by the thread that runs
+//  a search and returned when it is done, so concurrent queries never share one. They are kept per NUMA node, to
+//  stay in the memory of the node whose threads first touched them.
+class WorkspacePool {
+public:
+    template <typename Workspace>
+    std::shared_ptr<Workspace> acquire(const size_t node, const size_t vertex_count) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<std::shared_ptr<void>> &idle = workspaces[std::make_pair(std::type_index(typeid(Workspace)), node)];
+            if (!idle.empty()) {
+                std::shared_ptr<void> workspace = idle.back();
+                idle.pop_back();
+                return std::static_pointer_cast<Workspace>(workspace);
+            }
+        }
+        return std::make_shared<Workspace>(vertex_count);
+    }
+
+    // Returns a workspace after a search that completed, and so left it in its between-searches state.
+    template <typename Workspace>
+    void release(const size_t node, const std::shared_ptr<Workspace> &workspace) {
+        std::lock_guard<std::mutex> lock(mutex);
+        workspaces[std::make_pair(std::type_index(typeid(Workspace)), node)].push_back(workspace);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        workspaces.clear();
+    }
+
+private:
+    std::mutex mutex;
+    std::map<std::pair<std::type_index, size_t>, std::vector<std::shared_ptr<void>>> workspaces;
+};
+
+// Undirected router graph, in two phases: add_edge() builds it, and freeze() turns it into an immutable CSR layout.
+//  All queries are const and require a frozen graph, so any number of them can run concurrently, from OpenMP
+//  threads or from Python threads (the bindings release the GIL while a query runs). The few methods that add
+//  arrays to a frozen graph, such as build_contraction_hierarchy(), throw while a query runs, and a query throws
+//  while one of them runs, so no query ever reads an array that is being replaced.
+class Graph {
+public:
+    static const unsigned int NO_VERTEX = UINT32_MAX;
+
+    // Direction-optimizing BFS switches to bottom-up when the frontier has more than 1/ALPHA of the unexplored edges,
+    //  and back to top-down when it holds fewer than 1/BETA of all vertices (Beamer et al., SC'12).
+    static const size_t BOTTOM_UP_ALPHA = 14;
+    static const size_t BOTTOM_UP_BETA = 24;
+
+    // The deepest level a search that keeps hop counts can reach without overflowing Distance.
+    static const size_t MAX_DISTANCE = std::numeric_limits<Distance>::max();
+
+    // Mean Earth radius for great-circle distances. Edge weights are stored as floats, so the A* heuristic is
+    //  scaled down by HEURISTIC_SCALE to stay below any sum of rounded weights.
+    static constexpr double EARTH_RADIUS_KM = 6371.0088;
+    static constexpr double HEURISTIC_SCALE = 1 - 1e-6;
+
+    // A witness search during contraction gives up after settling this many vertices and adds the shortcut,
+    //  which keeps preprocessing time bounded at the cost of some unneeded shortcuts.
+    static const size_t WITNESS_SETTLE_LIMIT = 500;
+    static const uint64_t HIERARCHY_FILE_MAGIC = 0x4843204b44544931ULL;
+    static const uint32_t HIERARCHY_FILE_VERSION = 1;
+    static const uint64_t ORACLE_FILE_MAGIC = 0x4c4c50204b445449ULL;
+    static const uint32_t ORACLE_FILE_VERSION = 1;
+    static const uint64_t SNAPSHOT_FILE_MAGIC = 0x48505247204b4454ULL;
+    static const uint32_t SNAPSHOT_FILE_VERSION = 3;
+    static const size_t SNAPSHOT_ALIGNMENT = 64;
+
+    Graph() : node_level(false), running_queries(0), updating(false), frozen(false) {}
+
+    // The path searches below take max_hops, which gives up on a source once no destination is within that many
+    //  hops and returns an empty path for it (0 for no limit). This ends the searches of sources without a path
+    //  early, instead of exploring their whole connected component.
+    std::vector<std::vector<unsigned int>> parallelDijkstra(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations, const size_t max_hops) const {
+        const QueryScope query(*this);
+        return parallel_search<SearchWorkspace>(src_ips, endpoints(destinations), [max_hops](const Graph &graph, SearchWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+            return graph.dijkstra(workspace, src_ip, targets, max_hops);
+        });
+    }
+
+    // Same results as parallelDijkstra(), using the unit-weight BFS engine.
+    std::vector<std::vector<unsigned int>> parallelBFS(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations, const size_t max_hops) const {
+        const QueryScope query(*this);
+        return parallel_search<SearchWorkspace>(src_ips, endpoints(destinations), [max_hops](const Graph &graph, SearchWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+            return graph.bfs(workspace, src_ip, targets, max_hops);
+        });
+    }
+
+    // Returns for each source, in the order of src_ips, the IPs within radius hops of it, grouped by hop count:
+    //  element d holds the IPs exactly d hops away, in ascending order. The radius is at most MAX_DISTANCE.
+    std::vector<std::vector<std::vector<unsigned int>>> parallelRadius(const std::vector<unsigned int>& src_ips, const size_t radius) const {
+        const QueryScope query(*this);
+        if (radius > MAX_DISTANCE) {
+            throw std::invalid_argument("radius must be at most " + std::to_string(MAX_DISTANCE) + "; rebuild with a larger GRAPH_DISTANCE_BITS");
+        }
+        std::vector<std::vector<std::vector<unsigned int>>> results(src_ips.size());
+        std::atomic<size_t> completed(0);
+        parallel_items<SearchWorkspace>(src_ips.size(), [&](const Graph &graph, SearchWorkspace &workspace, const size_t i) {
+            results[i] = graph.vertices_within(workspace, src_ips[i], radius);
+            report_progress(++completed, src_ips.size());
+        });
+        return results;
+    }
+
+    // Distance-minimal routes over the edge weights set from coordinates, by A* per source: the heuristic is the
+    //  great-circle distance to the nearest destination, which never overestimates, so the routes are as short
+    //  in km as Dijkstra's while expanding only the vertices roughly on the way. Returns one path per source in
+    //  the order of src_ips, empty if no destination is reachable.
+    std::vector<std::vector<unsigned int>> parallelAStar(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations) const {
+        const QueryScope query(*this);
+        require_coordinates();
+        const Endpoints targets = endpoints(destinations);
+        const std::vector<double> target_positions = unique_positions(targets);
+        return parallel_search<AStarWorkspace>(src_ips, targets, [&target_positions](const Graph &graph, AStarWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+            return graph.astar(workspace, src_ip, targets, target_positions);
+        });
+    }
+
+    // Same distance-minimal routes as parallelAStar(), answered from the contraction hierarchy: one upward search
+    //  from all destinations, shared by every source, and one upward search per source that stops once no
+    //  unsettled vertex can improve on the best meeting point. Shortcuts on the route are unpacked into the
+    //  vertices they bypass. Ties between routes of equal length may be broken differently than parallelAStar().
+    std::vector<std::vector<unsigned int>> parallelCHSearch(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations) const {
+        const QueryScope query(*this);
+        require_hierarchy();
+        const Endpoints targets = endpoints(destinations);
+        const UpwardSearchSpace backward = upward_search(targets);
+        return parallel_search<AStarWorkspace>(src_ips, targets, [&backward](const Graph &graph, AStarWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+            return graph.ch_search(workspace, src_ip, targets, backward);
+        });
+    }
+
+    // Builds the shortest-path DAG from each source to its nearest destinations in one BFS, keeping every
+    //  predecessor at distance d-1 instead of one. Returns for each source, in the order of src_ips, the number of
+    //  equal-hop paths, the fraction of them through each vertex, and a stratified sample of up to max_paths of
+    //  them (all of them if there are that few), in lexicographic order of vertex IPs.
+    std::vector<ECMPPaths> parallelECMP(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations, const size_t max_paths) const {
+        const QueryScope query(*this);
+        const Endpoints targets = endpoints(destinations);
+        std::vector<ECMPPaths> results(src_ips.size());
+        std::atomic<size_t> completed(0);
+        parallel_items<ECMPWorkspace>(src_ips.size(), [&](const Graph &graph, ECMPWorkspace &workspace, const size_t i) {
+            results[i] = graph.ecmp(workspace, src_ips[i], targets, max_paths);
+            report_progress(++completed, src_ips.size());
+        });
+        return results;
+    }
+
+    // Finds the k fewest-hop loopless paths from each source to the destinations with Yen's algorithm, where a
+    //  path ends at the first destination it reaches. The sources are spread over all cores, and every spur search
+    //  reuses its thread's workspace. Returns for each source, in the order of src_ips, up to k paths in order of
+    //  hop count; the first is the one parallelBFS() finds, and ties are broken the same way as there.
+    std::vector<std::vector<std::vector<unsigned int>>> parallelKShortestPaths(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations, const size_t k) const {
+        const QueryScope query(*this);
+        const Endpoints targets = endpoints(destinations);
+        std::vector<std::vector<std::vector<unsigned int>>> results(src_ips.size());
+        std::atomic<size_t> completed(0);
+        parallel_items<SearchWorkspace>(src_ips.size(), [&](const Graph &graph, SearchWorkspace &workspace, const size_t i) {
+            results[i] = graph.k_shortest_paths(workspace, src_ips[i], targets, k);
+            report_progress(++completed, src_ips.size());
+        });
+        return results;
+    }
+
+    // Runs a single multi-source BFS seeded from all destinations and reads each source's path off the resulting
+    //  parent forest, so the cost is one traversal per destination set rather than one per source. Returns one path
+    //  per source in the order of src_ips, empty if no destination is reachable. Hop counts match parallelBFS(), but
+    //  ties between equally short routes can be broken differently.
+    std::vector<std::vector<unsigned int>> reverseBFS(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations, const size_t max_hops) const {
+        const QueryScope query(*this);
+        const std::shared_ptr<SearchWorkspace> workspace = workspace_pool.acquire<SearchWorkspace>(0, vertex_ips.size());
+        std::vector<std::vector<unsigned int>> paths = reverse_bfs(*workspace, src_ips, endpoints(std::set<unsigned int>(src_ips.begin(), src_ips.end())), endpoints(destinations), max_hops);
+        workspace_pool.release(0, workspace);
+        return paths;
+    }
+
+    // Same paths as parallelBFS(), using the bit-parallel multi-source BFS engine: batch_size (64, 128, 256 or 512)
+    //  sources share each traversal, so edges scanned on behalf of several sources in a batch are read only once.
+    //  Each thread keeps two masks of batch_size bits per vertex. Returns one path per source in the order of src_ips.
+    std::vector<std::vector<unsigned int>> parallelMSBFS(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations, const size_t batch_size, const size_t max_hops) const {
+        switch (batch_size) {
+            case 64:
+                return parallel_msbfs<1>(src_ips, destinations, max_hops);
+            case 128:
+                return parallel_msbfs<2>(src_ips, destinations, max_hops);
+            case 256:
+                return parallel_msbfs<4>(src_ips, destinations, max_hops);
+            case 512:
+                return parallel_msbfs<8>(src_ips, destinations, max_hops);
+            default:
+                throw std::invalid_argument("batch_size must be one of 64, 128, 256 or 512");
+        }
+    }
+
+    // Bidirectional BFS per source, for single-pair or small-batch lookups: grows one search from the source and
+    //  one from the whole destination set, and stops as soon as they meet. Returns one path per source in the order
+    //  of src_ips, with the same hop count as parallelBFS().
+    std::vector<std::vector<unsigned int>> parallelBidirectionalBFS(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations, const size_t max_hops) const {
+        const QueryScope query(*this);
+        return parallel_search<BidirectionalWorkspace>(src_ips, endpoints(destinations), [max_hops](const Graph &graph, BidirectionalWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+            return graph.bidirectional_bfs(workspace, src_ip, targets, max_hops);
+        });
+    }
+
+    typedef std::map<std::string, std::vector<unsigned int>> LabelledIPs;
+    typedef std::map<std::string, std::vector<std::vector<unsigned int>>> LabelPaths;
+    typedef std::map<std::pair<std::string, std::string>, std::vector<std::vector<unsigned int>>> LabelPairPaths;
+
+    // Runs one BFS per source toward all labelled destination groups at once, and keeps going until it has found
+    //  the nearest destination of every label, or until max_hops levels (0 for no limit). Returns the paths keyed by
+    //  label, one per source in the order of src_ips, each the same as parallelBFS() to that group alone would find.
+    LabelPaths parallelMultiTargetBFS(const std::vector<unsigned int>& src_ips, const LabelledIPs &dst_groups, const size_t max_hops) const {
+        const QueryScope query(*this);
+        const LabelledEndpoints destinations = labelled_endpoints(dst_groups);
+
+        LabelPaths results;
+        std::vector<std::vector<std::vector<std::vector<unsigned int>> *>> paths(1);
+        for (const auto &label : destinations.labels) {
+            paths[0].push_back(&results[label]);
+        }
+        parallel_multi_target(std::vector<const std::vector<unsigned int> *>(1, &src_ips), destinations, max_hops, paths);
+        return results;
+    }
+
+    // Number of vertices that the search of parallelMultiTargetBFS() from src_ip visits, which shows how early it
+    //  stops: it only exhausts the component of src_ip when some label is in the graph but out of reach.
+    size_t multiTargetVisitedCount(const unsigned int &src_ip, const LabelledIPs &dst_groups, const size_t max_hops) const {
+        const QueryScope query(*this);
+        const std::shared_ptr<SearchWorkspace> workspace = workspace_pool.acquire<SearchWorkspace>(0, vertex_ips.size());
+        workspace->reset();
+        multi_target_bfs(*workspace, src_ip, labelled_endpoints(dst_groups), max_hops);
+        size_t visited = 0;
+        for (unsigned int vertex = 0; vertex < vertex_ips.size(); ++vertex) {
+            visited += workspace->visited(vertex);
+        }
+        workspace_pool.release(0, workspace);
+        return visited;
+    }
+
+    // Finds the routes of every (source group, destination group) pair in one call, keyed by (source label,
+    //  destination label) with one path per source in group order. Pairs of the same non-empty label are skipped.
+    //  Every group is resolved to vertices once, and the work of all pairs is scheduled across the cores together,
+    //  so no pair waits for the slowest search of the previous one. algorithm is "reverse-bfs" (one task per pair),
+    //  "bfs", "dijkstra", "bidirectional", "astar" or "ch" (one task per source and pair), or "multi-target" (one
+    //  task per source, covering all destination groups). max_hops bounds the hop-count searches as in parallelBFS().
+    LabelPairPaths parallelGroupPairs(const LabelledIPs &src_groups, const LabelledIPs &dst_groups, const std::string &algorithm, const size_t max_hops) const {
+        const QueryScope query(*this);
+
+        std::map<std::string, Endpoints> destinations;
+        for (const auto &group : dst_groups) {
+            destinations[group.first] = endpoints(std::set<unsigned int>(group.second.begin(), group.second.end()));
+        }
+
+        LabelPairPaths results;
+        std::vector<SearchTask> tasks;
+        for (const auto &src_group : src_groups) {
+            for (const auto &dst_group : dst_groups) {
+                if (!src_group.first.empty() && src_group.first == dst_group.first) {
+                    continue;
+                }
+                SearchTask task;
+                task.src_ips = &src_group.second;
+                task.destinations = &destinations[dst_group.first];
+                task.paths = &results[std::make_pair(src_group.first, dst_group.first)];
+                tasks.push_back(task);
+            }
+        }
+
+        if (algorithm == "reverse-bfs") {
+            std::map<const std::vector<unsigned int> *, Endpoints> sources;
+            for (const auto &src_group : src_groups) {
+                sources[&src_group.second] = endpoints(std::set<unsigned int>(src_group.second.begin(), src_group.second.end()));
+            }
+            std::atomic<size_t> completed(0);
+            parallel_items<SearchWorkspace>(tasks.size(), [&](const Graph &graph, SearchWorkspace &workspace, const size_t i) {
+                *tasks[i].paths = graph.reverse_bfs(workspace, *tasks[i].src_ips, sources.find(tasks[i].src_ips)->second, *tasks[i].destinations, max_hops);
+                report_progress(++completed, tasks.size());
+            });
+        } else if (algorithm == "multi-target") {
+            const LabelledEndpoints targets = labelled_endpoints(dst_groups);
+            std::vector<const std::vector<unsigned int> *> src_ips;
+            std::vector<std::vector<std::vector<std::vector<unsigned int>> *>> paths;
+            for (const auto &src_group : src_groups) {
+                src_ips.push_back(&src_group.second);
+                paths.emplace_back();
+                for (const auto &label : targets.labels) {
+                    auto it = results.find(std::make_pair(src_group.first, label));
+                    paths.back().push_back(it != results.end() ? &it->second : nullptr);
+                }
+            }
+            parallel_multi_target(src_ips, targets, max_hops, paths);
+        } else if (algorithm == "bfs") {
+            parallel_search<SearchWorkspace>(tasks, [max_hops](const Graph &graph, SearchWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+                return graph.bfs(workspace, src_ip, targets, max_hops);
+            });
+        } else if (algorithm == "dijkstra") {
+            parallel_search<SearchWorkspace>(tasks, [max_hops](const Graph &graph, SearchWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+                return graph.dijkstra(workspace, src_ip, targets, max_hops);
+            });
+        } else if (algorithm == "astar") {
+            require_coordinates();
+            std::map<const Endpoints *, std::vector<double>> target_positions;
+            for (const auto &group : destinations) {
+                target_positions[&group.second] = unique_positions(group.second);
+            }
+            parallel_search<AStarWorkspace>(tasks, [&target_positions](const Graph &graph, AStarWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+                return graph.astar(workspace, src_ip, targets, target_positions.find(&targets)->second);
+            });
+        } else if (algorithm == "ch") {
+            require_hierarchy();
+            std::map<const Endpoints *, UpwardSearchSpace> backward;
+            for (const auto &group : destinations) {
+                backward[&group.second] = upward_search(group.second);
+            }
+            parallel_search<AStarWorkspace>(tasks, [&backward](const Graph &graph, AStarWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+                return graph.ch_search(workspace, src_ip, targets, backward.find(&targets)->second);
+            });
+        } else if (algorithm == "bidirectional") {
+            parallel_search<BidirectionalWorkspace>(tasks, [max_hops](const Graph &graph, BidirectionalWorkspace &workspace, const unsigned int &src_ip, const Endpoints &targets) {
+                return graph.bidirectional_bfs(workspace, src_ip, targets, max_hops);
+            });
+        } else {
+            throw std::invalid_argument("Unsupported algorithm: " + algorithm);
+        }
+        return results;
+    }
+
+    void reserve(const size_t size) {
+        if (frozen.load(std::memory_order_acquire)) {
+            throw std::logic_error("Cannot reserve space in a frozen graph");
+        }
+        graph.reserve(size);
+    }
+
+    void add_edge(const unsigned int &u, const unsigned int &v) {
+        if (frozen.load(std::memory_order_acquire)) {
+            throw std::logic_error("Cannot add edges to a frozen graph");
+        }
+        graph[u].insert(v);
+        graph[v].insert(u);
+    }
+
+    // Adds the edges of an ITDK links file (midar-iff.links) between every two IPs of the nodes on each link, with
+    //  node_ips from node IDs to their IPs as strings; links with fewer than two known IPs add none. The file, plain
+    //  or compressed as in parse_lines(), is parsed on all cores, and the edges go straight into the adjacency
+    //  list. Returns the number of links that added edges.
+    size_t add_links(const std::string &link_file, const std::unordered_map<std::string, std::vector<std::string>> &node_ips) {
+        NodeIPs nodes;
+        std::vector<std::pair<size_t, const std::vector<std::string> *>> numbered;
+        numbered.reserve(node_ips.size());
+        size_t node_count = 0;
+        for (const auto &entry : node_ips) {
+            size_t node;
+            if (!parse_node_id(entry.first.data(), entry.first.data() + entry.first.size(), node)) {
+                throw std::invalid_argument("Not an ITDK node ID: " + entry.first);
+            }
+            numbered.push_back(std::make_pair(node, &entry.second));
+            node_count = std::max(node_count, node + 1);
+        }
+        nodes.offsets.assign(node_count + 1, 0);
+        for (const auto &entry : numbered) {
+            nodes.offsets[entry.first + 1] = entry.second->size();
+        }
+        for (size_t n = 0; n < node_count; ++n) {
+            nodes.offsets[n + 1] += nodes.offsets[n];
+        }
+        nodes.ips.resize(nodes.offsets.back());
+        for (const auto &entry : numbered) {
+            size_t j = nodes.offsets[entry.first];
+            for (const auto &ip : *entry.second) {
+                if (!parse_ipv4(ip.data(), ip.data() + ip.size(), nodes.ips[j++])) {
+                    throw std::invalid_argument("Not an IPv4 address: " + ip);
+                }
+            }
+        }
+        return add_links(link_file, nodes);
+    }
+
+    // Same as above, with the IPs of each node from a NodeIPs.
+    size_t add_links(const std::string &link_file, const NodeIPs &nodes) {
+        return add_link_edges(link_file, nodes, false);
+    }
+
+    // Builds a node-level graph instead: its vertices are the numbers of the node IDs (node N123 is 123) and each
+    //  link adds an edge between every two of its nodes with IPs in nodes, so a router is one vertex however many
+    //  interfaces it has. Paths are then between routers; NodeIPs::nodes_of() maps IPs to their vertices.
+    size_t add_node_links(const std::string &link_file, const NodeIPs &nodes) {
+        return add_link_edges(link_file, nodes, true);
+    }
+
+    bool is_node_level() const {
+        return node_level;
+    }
+
+    // Adds the edges of a links file between the IPs of its nodes, or between the nodes themselves if node_level.
+    size_t add_link_edges(const std::string &link_file, const NodeIPs &nodes, const bool node_level) {
+        if (frozen.load(std::memory_order_acquire)) {
+            throw std::logic_error("Cannot add edges to a frozen graph");
+        }
+        if (!graph.empty() && node_level != this->node_level) {
+            throw std::logic_error("Cannot add node-level and interface-level edges to the same graph");
+        }
+        this->node_level = node_level;
+        const size_t shards = omp_get_max_threads();
+
+        // Each piece of the file sorts its edges by the shard of their first end, so that every shard of the
+        //  adjacency list is then filled by one thread without locks. Both directions of each edge are kept.
+        struct Piece {
+            size_t links = 0;
+            std::vector<std::vector<std::pair<unsigned int, unsigned int>>> edges;
+        };
+        std::vector<Piece> pieces = parse_lines<Piece>(link_file, [&nodes, shards, node_level](const char *line, const char *end, Piece &piece) {
+            std::vector<unsigned int> interfaces;
+            piece.edges.resize(shards);
+            while (line < end) {
+                const void *newline = std::memchr(line, '\n', end - line);
+                const char *line_end = newline ? static_cast<const char *>(newline) : end;
+                if (parse_link(line, line_end, nodes, node_level, interfaces)) {
+                    if (interfaces.size() > 1) {
+                        for (size_t i = 0; i < interfaces.size(); ++i) {
+                            for (size_t j = i + 1; j < interfaces.size(); ++j) {
+                                piece.edges[vertex_shard(interfaces[i], shards)].push_back(std::make_pair(interfaces[i], interfaces[j]));
+                                piece.edges[vertex_shard(interfaces[j], shards)].push_back(std::make_pair(interfaces[j], interfaces[i]));
+                            }
+                        }
+                        ++piece.links;
+                    }
+                } else if (line != line_end && *line != '#') {
+                    std::cerr << "Cannot process line: " + std::string(line, line_end) + "\n";
+                }
+                line = line_end + 1;
+            }
+        });
+        size_t link_count = 0;
+        for (const auto &piece : pieces) {
+            link_count += piece.links;
+        }
+
+        std::vector<std::unordered_map<unsigned int, std::unordered_set<unsigned int>>> adjacency(shards);
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t shard = 0; shard < shards; ++shard) {
+            for (auto &piece : pieces) {
+                if (piece.edges.empty()) {
+                    continue;
+                }
+                for (const auto &edge : piece.edges[shard]) {
+                    adjacency[shard][edge.first].insert(edge.second);
+                }
+                std::vector<std::pair<unsigned int, unsigned int>>().swap(piece.edges[shard]);
+            }
+        }
+
+        for (auto &shard : adjacency) {
+            for (auto &entry : shard) {
+                auto inserted = graph.emplace(entry.first, std::unordered_set<unsigned int>());
+                if (inserted.second) {
+                    inserted.first->second.swap(entry.second);
+                } else {
+                    inserted.first->second.insert(entry.second.begin(), entry.second.end());
+                }
+            }
+            std::unordered_map<unsigned int, std::unordered_set<unsigned int>>().swap(shard);
+        }
+        return link_count;
+    }
+
+    // Sets the location of a router interface, in degrees. Once any IP has a location, freeze() requires one for
+    //  every vertex and weighs each edge by the great-circle km between its ends, for parallelAStar().
+    void set_coordinates(const unsigned int &ip, const double &latitude, const double &longitude) {
+        if (frozen.load(std::memory_order_acquire)) {
+            throw std::logic_error("Cannot set coordinates in a frozen graph");
+        }
+        coordinates[ip] = std::make_pair(latitude, longitude);
+    }
+
+    // Sets the location of every IP of the given nodes, such as "N123", from their latitudes and longitudes, or of
+    //  the nodes themselves in a node-level graph.
+    void set_node_coordinates(const NodeIPs &nodes, const std::vector<std::string> &node_ids, const std::vector<double> &latitudes, const std::vector<double> &longitudes) {
+        if (node_ids.size() != latitudes.size() || node_ids.size() != longitudes.size()) {
+            throw std::invalid_argument("node_ids, latitudes and longitudes must have the same length");
+        }
+        for (size_t i = 0; i < node_ids.size(); ++i) {
+            size_t node;
+            if (!node_level) {
+                for (const auto &ip : nodes.ips_of(node_ids[i])) {
+                    set_coordinates(ip, latitudes[i], longitudes[i]);
+                }
+            } else if (parse_node_id(node_ids[i].data(), node_ids[i].data() + node_ids[i].size(), node) && node < nodes.node_count()
+                       && nodes.offsets[node] < nodes.offsets[node + 1]) {
+                set_coordinates(node, latitudes[i], longitudes[i]);
+            }
+        }
+    }
+
+    // Convert the adjacency list into the CSR layout. All queries run on the CSR afterwards, and no more edges can
+    //  be added.
+    void freeze() {
+        if (frozen.load(std::memory_order_acquire)) {
+            return;
+        }
+        if (!coordinates.empty()) {
+            for (const auto &pair : graph) {
+                if (coordinates.find(pair.first) == coordinates.end()) {
+                    throw std::logic_error("Missing coordinates for IP " + std::to_string(pair.first));
+                }
+            }
+        }
+
+        std::vector<unsigned int> ips;
+        ips.reserve(graph.size());
+        for (const auto &pair : graph) {
+            ips.push_back(pair.first);
+        }
+        std::sort(ips.begin(), ips.end());
+        vertex_ips = FrozenArray<unsigned int>(std::move(ips));
+
+        std::vector<size_t> csr_offsets(vertex_ips.size() + 1, 0);
+        for (size_t i = 0; i < vertex_ips.size(); ++i) {
+            csr_offsets[i + 1] = csr_offsets[i] + graph.find(vertex_ips[i])->second.size();
+        }
+
+        std::vector<unsigned int> csr_neighbors(csr_offsets.back());
+        #pragma omp parallel for schedule(dynamic, 4096)
+        for (size_t i = 0; i < vertex_ips.size(); ++i) {
+            // Only the mapped value is modified here, so concurrent find() on the map itself is safe.
+            auto &adjacent_ips = graph.find(vertex_ips[i])->second;
+            size_t j = csr_offsets[i];
+            for (const auto &neighbor_ip : adjacent_ips) {
+                csr_neighbors[j++] = vertex_index(neighbor_ip);
+            }
+            std::sort(csr_neighbors.begin() + csr_offsets[i], csr_neighbors.begin() + csr_offsets[i + 1]);
+            std::unordered_set<unsigned int>().swap(adjacent_ips);
+        }
+        offsets = FrozenArray<size_t>(std::move(csr_offsets));
+        neighbors = FrozenArray<unsigned int>(std::move(csr_neighbors));
+
+        std::unordered_map<unsigned int, std::unordered_set<unsigned int>>().swap(graph);
+
+        if (!coordinates.empty()) {
+            std::vector<double> vertex_positions(3 * vertex_ips.size());
+            for (size_t i = 0; i < vertex_ips.size(); ++i) {
+                const std::pair<double, double> &location = coordinates.find(vertex_ips[i])->second;
+                const double latitude = location.first * M_PI / 180;
+                const double longitude = location.second * M_PI / 180;
+                vertex_positions[3 * i] = std::cos(latitude) * std::cos(longitude);
+                vertex_positions[3 * i + 1] = std::cos(latitude) * std::sin(longitude);
+                vertex_positions[3 * i + 2] = std::sin(latitude);
+            }
+            positions = FrozenArray<double>(std::move(vertex_positions));
+            std::unordered_map<unsigned int, std::pair<double, double>>().swap(coordinates);
+
+            std::vector<float> edge_weights(neighbors.size());
+            #pragma omp parallel for schedule(dynamic, 4096)
+            for (size_t i = 0; i < vertex_ips.size(); ++i) {
+                for (size_t j = offsets[i]; j < offsets[i + 1]; ++j) {
+                    edge_weights[j] = great_circle_km(&positions[3 * i], &positions[3 * neighbors[j]]);
+                }
+            }
+            weights = FrozenArray<float>(std::move(edge_weights));
+        }
+        frozen.store(true, std::memory_order_release);
+    }
+
+    // Preprocesses the weighted graph into a contraction hierarchy for parallelCHSearch(). Vertices are contracted
+    //  in order of edge difference (shortcuts added minus edges removed, plus contracted neighbors), updated
+    //  lazily; contracting a vertex adds a shortcut between two of its neighbors unless a witness search finds a
+    //  path at most as long around it. Like load_contraction_hierarchy(), it fails while queries are running, and
+    //  queries fail while it runs.
+    void build_contraction_hierarchy() {
+        const UpdateScope update(*this);
+        require_coordinates();
+        const size_t count = vertex_ips.size();
+
+        // Edges among the vertices not contracted yet, starting from the graph's.
+        std::vector<std::vector<ShortcutEdge>> remaining(count);
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t j = offsets[i]; j < offsets[i + 1]; ++j) {
+                ShortcutEdge edge = { neighbors[j], NO_VERTEX, weights[j] };
+                remaining[i].push_back(edge);
+            }
+        }
+
+        AStarWorkspace workspace(count);
+        std::vector<unsigned int> contracted_neighbors(count, 0);
+        std::vector<std::vector<ShortcutEdge>> upward(count);
+        std::vector<std::pair<unsigned int, ShortcutEdge>> shortcuts;
+        std::priority_queue<std::pair<int64_t, unsigned int>, std::vector<std::pair<int64_t, unsigned int>>, std::greater<std::pair<int64_t, unsigned int>>> queue;
+        for (unsigned int vertex = 0; vertex < count; ++vertex) {
+            find_shortcuts(workspace, remaining, vertex, shortcuts);
+            queue.push(std::make_pair(edge_difference(remaining, contracted_neighbors, vertex, shortcuts), vertex));
+        }
+
+        std::vector<unsigned int> rank(count);
+        unsigned int next_rank = 0;
+        while (!queue.empty()) {
+            const unsigned int vertex = queue.top().second;
+            queue.pop();
+            find_shortcuts(workspace, remaining, vertex, shortcuts);
+            const int64_t priority = edge_difference(remaining, contracted_neighbors, vertex, shortcuts);
+            if (!queue.empty() && priority > queue.top().first) {
+                queue.push(std::make_pair(priority, vertex));
+                continue;
+            }
+
+            rank[vertex] = next_rank++;
+            for (const auto &edge : remaining[vertex]) {
+                std::vector<ShortcutEdge> &edges = remaining[edge.target];
+                for (size_t k = 0; k < edges.size(); ++k) {
+                    if (edges[k].target == vertex) {
+                        edges[k] = edges.back();
+                        edges.pop_back();
+                        break;
+                    }
+                }
+                ++contracted_neighbors[edge.target];
+            }
+            for (const auto &shortcut : shortcuts) {
+                add_shortcut(remaining[shortcut.first], shortcut.second);
+                ShortcutEdge reverse = { shortcut.first, vertex, shortcut.second.weight };
+                add_shortcut(remaining[shortcut.second.target], reverse);
+            }
+            upward[vertex].swap(remaining[vertex]);
+        }
+
+        std::vector<size_t> upward_offsets(count + 1, 0);
+        for (size_t i = 0; i < count; ++i) {
+            upward_offsets[i + 1] = upward_offsets[i] + upward[i].size();
+        }
+        std::vector<ShortcutEdge> upward_edges;
+        upward_edges.reserve(upward_offsets.back());
+        for (size_t i = 0; i < count; ++i) {
+            std::sort(upward[i].begin(), upward[i].end(), [](const ShortcutEdge &a, const ShortcutEdge &b) {
+                return a.target < b.target;
+            });
+            upward_edges.insert(upward_edges.end(), upward[i].begin(), upward[i].end());
+            std::vector<ShortcutEdge>().swap(upward[i]);
+        }
+        hierarchy_rank = FrozenArray<unsigned int>(std::move(rank));
+        hierarchy_offsets = FrozenArray<size_t>(std::move(upward_offsets));
+        hierarchy_edges = FrozenArray<ShortcutEdge>(std::move(upward_edges));
+        share_with_numa_replicas();
+    }
+
+    // Builds the hop-distance oracle: a 2-hop cover by pruned landmark labelling (Akiba et al., SIGMOD'13). Each
+    //  vertex in turn, in descending order of degree, runs a BFS that adds (vertex, hops) to the label of every
+    //  vertex it reaches, but prunes the BFS wherever the labels built so far already give a distance at most as
+    //  short. The distance between any two vertices is then the minimum over the landmarks their labels share.
+    //  Like load_distance_oracle(), it fails while queries are running, and queries fail while it runs.
+    void build_distance_oracle() {
+        const UpdateScope update(*this);
+        const size_t count = vertex_ips.size();
+        std::vector<unsigned int> order(count);
+        for (unsigned int vertex = 0; vertex < count; ++vertex) {
+            order[vertex] = vertex;
+        }
+        std::stable_sort(order.begin(), order.end(), [this](const unsigned int &a, const unsigned int &b) {
+            return degree(a) > degree(b);
+        });
+
+        std::vector<std::vector<std::pair<unsigned int, Distance>>> labels(count);
+        // Distance from the current root to each landmark of its label, indexed by landmark rank, or -1.
+        std::vector<int32_t> root_label(count, -1);
+        SearchWorkspace workspace(count);
+        std::vector<unsigned int> &frontier = workspace.frontier;
+        std::vector<unsigned int> &next_frontier = workspace.next_frontier;
+        for (unsigned int rank = 0; rank < count; ++rank) {
+            const unsigned int root = order[rank];
+            for (const auto &entry : labels[root]) {
+                root_label[entry.first] = entry.second;
+            }
+
+            workspace.reset();
+            workspace.visit(root, root);
+            frontier.push_back(root);
+            for (size_t hops = 0; !frontier.empty(); ++hops) {
+                if (hops > MAX_DISTANCE) {
+                    throw std::overflow_error("Hop distance exceeds " + std::to_string(MAX_DISTANCE) + "; rebuild with a larger GRAPH_DISTANCE_BITS");
+                }
+                next_frontier.clear();
+                for (const auto &vertex : frontier) {
+                    bool covered = false;
+                    for (const auto &entry : labels[vertex]) {
+                        if (root_label[entry.first] >= 0 && static_cast<size_t>(root_label[entry.first] + entry.second) <= hops) {
+                            covered = true;
+                            break;
+                        }
+                    }
+                    if (covered) {
+                        continue;
+                    }
+                    labels[vertex].push_back(std::make_pair(rank, static_cast<Distance>(hops)));
+                    for (size_t j = offsets[vertex]; j < offsets[vertex + 1]; ++j) {
+                        if (!workspace.visited(neighbors[j])) {
+                            workspace.visit(neighbors[j], vertex);
+                            next_frontier.push_back(neighbors[j]);
+                        }
+                    }
+                }
+                frontier.swap(next_frontier);
+            }
+
+            for (const auto &entry : labels[root]) {
+                root_label[entry.first] = -1;
+            }
+        }
+
+        // Flatten the labels, which are sorted by landmark rank since landmarks were processed in rank order.
+        std::vector<size_t> label_offsets(count + 1, 0);
+        for (size_t i = 0; i < count; ++i) {
+            label_offsets[i + 1] = label_offsets[i] + labels[i].size();
+        }
+        std::vector<unsigned int> landmarks(label_offsets.back());
+        std::vector<Distance> distances(label_offsets.back());
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t k = 0; k < labels[i].size(); ++k) {
+                landmarks[label_offsets[i] + k] = labels[i][k].first;
+                distances[label_offsets[i] + k] = labels[i][k].second;
+            }
+            std::vector<std::pair<unsigned int, Distance>>().swap(labels[i]);
+        }
+        oracle_offsets = FrozenArray<size_t>(std::move(label_offsets));
+        oracle_landmarks = FrozenArray<unsigned int>(std::move(landmarks));
+        oracle_distances = FrozenArray<Distance>(std::move(distances));
+        share_with_numa_replicas();
+    }
+
+    bool has_distance_oracle() const {
+        return !oracle_offsets.empty();
+    }
+
+    // Exact hop distance between two IPs from the oracle, or -1 if either is not in the graph or they are not
+    //  connected.
+    int hop_distance(const unsigned int &src_ip, const unsigned int &dst_ip) const {
+        const QueryScope query(*this);
+        require_oracle();
+        const unsigned int src = vertex_index(src_ip);
+        const unsigned int dst = vertex_index(dst_ip);
+        if (src == NO_VERTEX || dst == NO_VERTEX) {
+            return -1;
+        }
+        return label_distance(src, dst);
+    }
+
+    // Hop distances from each source to each destination, one row per source, as hop_distance().
+    std::vector<std::vector<int>> parallelHopDistances(const std::vector<unsigned int>& src_ips, const std::vector<unsigned int>& dst_ips) const {
+        const QueryScope query(*this);
+        require_oracle();
+        std::vector<unsigned int> destinations;
+        for (const auto &ip : dst_ips) {
+            destinations.push_back(vertex_index(ip));
+        }
+        std::vector<std::vector<int>> results(src_ips.size(), std::vector<int>(dst_ips.size(), -1));
+
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (size_t i = 0; i < src_ips.size(); ++i) {
+            const unsigned int src = vertex_index(src_ips[i]);
+            if (src == NO_VERTEX) {
+                continue;
+            }
+            for (size_t j = 0; j < destinations.size(); ++j) {
+                if (destinations[j] != NO_VERTEX) {
+                    results[i][j] = label_distance(src, destinations[j]);
+                }
+            }
+        }
+        return results;
+    }
+
+    // A shortest path between two IPs, recovered from the oracle by stepping to the lowest-index neighbor one hop
+    //  closer to the destination, or empty if there is none.
+    std::vector<unsigned int> oracle_path(const unsigned int &src_ip, const unsigned int &dst_ip) const {
+        const QueryScope query(*this);
+        const int distance = hop_distance(src_ip, dst_ip);
+        if (distance < 0) {
+            return {};
+        }
+        const unsigned int dst = vertex_index(dst_ip);
+        unsigned int current_node = vertex_index(src_ip);
+        std::vector<unsigned int> path(1, current_node);
+        for (int remaining = distance; remaining > 0; --remaining) {
+            for (size_t j = offsets[current_node]; j < offsets[current_node + 1]; ++j) {
+                if (label_distance(neighbors[j], dst) == remaining - 1) {
+                    current_node = neighbors[j];
+                    break;
+                }
+            }
+            path.push_back(current_node);
+        }
+        return to_ips(path);
+    }
+
+    // Writes the distance oracle to a binary file, tied to this graph by its vertex and edge counts.
+    void save_distance_oracle(const std::string &path) const {
+        const QueryScope query(*this);
+        require_oracle();
+        std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+        const uint64_t header[] = { ORACLE_FILE_MAGIC, ORACLE_FILE_VERSION, vertex_ips.size(), neighbors.size(), oracle_landmarks.size(), sizeof(Distance) };
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(oracle_offsets.data()), oracle_offsets.size() * sizeof(size_t));
+        file.write(reinterpret_cast<const char *>(oracle_landmarks.data()), oracle_landmarks.size() * sizeof(unsigned int));
+        file.write(reinterpret_cast<const char *>(oracle_distances.data()), oracle_distances.size() * sizeof(Distance));
+        if (!file) {
+            throw std::runtime_error("Cannot write distance oracle to " + path);
+        }
+    }
+
+    // Reads a distance oracle written by save_distance_oracle() for the same graph and distance width.
+    void load_distance_oracle(const std::string &path) {
+        const UpdateScope update(*this);
+        std::ifstream file(path.c_str(), std::ios::binary);
+        uint64_t header[6];
+        if (!file.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != ORACLE_FILE_MAGIC) {
+            throw std::runtime_error("Not a distance oracle file: " + path);
+        }
+        if (header[1] != ORACLE_FILE_VERSION) {
+            throw std::runtime_error("Unsupported distance oracle version " + std::to_string(header[1]) + " in " + path);
+        }
+        if (header[2] != vertex_ips.size() || header[3] != neighbors.size()) {
+            throw std::runtime_error("Distance oracle in " + path + " was built for a different graph");
+        }
+        if (header[5] != sizeof(Distance)) {
+            throw std::runtime_error("Distance oracle in " + path + " was built with " + std::to_string(8 * header[5]) + "-bit distances");
+        }
+
+        std::vector<size_t> offsets_read(vertex_ips.size() + 1);
+        std::vector<unsigned int> landmarks(header[4]);
+        std::vector<Distance> distances(header[4]);
+        file.read(reinterpret_cast<char *>(offsets_read.data()), offsets_read.size() * sizeof(size_t));
+        file.read(reinterpret_cast<char *>(landmarks.data()), landmarks.size() * sizeof(unsigned int));
+        file.read(reinterpret_cast<char *>(distances.data()), distances.size() * sizeof(Distance));
+        if (!file || offsets_read.back() != landmarks.size()) {
+            throw std::runtime_error("Truncated distance oracle file: " + path);
+        }
+        oracle_offsets = FrozenArray<size_t>(std::move(offsets_read));
+        oracle_landmarks = FrozenArray<unsigned int>(std::move(landmarks));
+        oracle_distances = FrozenArray<Distance>(std::move(distances));
+        share_with_numa_replicas();
+    }
+
+    bool has_contraction_hierarchy() const {
+        return !hierarchy_rank.empty();
+    }
+
+    // Writes the contraction hierarchy to a binary file, tied to this graph by its vertex and edge counts.
+    void save_contraction_hierarchy(const std::string &path) const {
+        const QueryScope query(*this);
+        require_hierarchy();
+        std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+        const uint64_t header[] = { HIERARCHY_FILE_MAGIC, HIERARCHY_FILE_VERSION, vertex_ips.size(), neighbors.size(), hierarchy_edges.size() };
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(hierarchy_rank.data()), hierarchy_rank.size() * sizeof(unsigned int));
+        file.write(reinterpret_cast<const char *>(hierarchy_offsets.data()), hierarchy_offsets.size() * sizeof(size_t));
+        file.write(reinterpret_cast<const char *>(hierarchy_edges.data()), hierarchy_edges.size() * sizeof(ShortcutEdge));
+        if (!file) {
+            throw std::runtime_error("Cannot write contraction hierarchy to " + path);
+        }
+    }
+
+    // Reads a contraction hierarchy written by save_contraction_hierarchy() for the same graph.
+    void load_contraction_hierarchy(const std::string &path) {
+        const UpdateScope update(*this);
+        std::ifstream file(path.c_str(), std::ios::binary);
+        uint64_t header[5];
+        if (!file.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != HIERARCHY_FILE_MAGIC) {
+            throw std::runtime_error("Not a contraction hierarchy file: " + path);
+        }
+        if (header[1] != HIERARCHY_FILE_VERSION) {
+            throw std::runtime_error("Unsupported contraction hierarchy version " + std::to_string(header[1]) + " in " + path);
+        }
+        if (header[2] != vertex_ips.size() || header[3] != neighbors.size()) {
+            throw std::runtime_error("Contraction hierarchy in " + path + " was built for a different graph");
+        }
+
+        std::vector<unsigned int> rank(vertex_ips.size());
+        std::vector<size_t> hierarchy_offsets_read(vertex_ips.size() + 1);
+        std::vector<ShortcutEdge> edges(header[4]);
+        file.read(reinterpret_cast<char *>(rank.data()), rank.size() * sizeof(unsigned int));
+        file.read(reinterpret_cast<char *>(hierarchy_offsets_read.data()), hierarchy_offsets_read.size() * sizeof(size_t));
+        file.read(reinterpret_cast<char *>(edges.data()), edges.size() * sizeof(ShortcutEdge));
+        if (!file || hierarchy_offsets_read.back() != edges.size()) {
+            throw std::runtime_error("Truncated contraction hierarchy file: " + path);
+        }
+        hierarchy_rank = FrozenArray<unsigned int>(std::move(rank));
+        hierarchy_offsets = FrozenArray<size_t>(std::move(hierarchy_offsets_read));
+        hierarchy_edges = FrozenArray<ShortcutEdge>(std::move(edges));
+        share_with_numa_replicas();
+    }
+
+    // Writes the frozen graph to a versioned, checksummed snapshot that load() maps read-only: the CSR and its IP
+    //  index, plus the coordinates, contraction hierarchy and distance oracle when present. The file is written
+    //  beside path and renamed into place, so a reader never sees a partial snapshot, and removed if saving fails.
+    void save(const std::string &path) const {
+        const QueryScope query(*this);
+        const std::pair<const char *, size_t> sections[SECTION_COUNT] = {
+            snapshot_section(vertex_ips),
+            snapshot_section(offsets),
+            snapshot_section(neighbors),
+            snapshot_section(positions),
+            snapshot_section(weights),
+            snapshot_section(hierarchy_rank),
+            snapshot_section(hierarchy_offsets),
+            snapshot_section(hierarchy_edges),
+            snapshot_section(oracle_offsets),
+            snapshot_section(oracle_landmarks),
+            snapshot_section(oracle_distances)
+        };
+
+        SnapshotHeader header = SnapshotHeader();
+        header.magic = SNAPSHOT_FILE_MAGIC;
+        header.version = SNAPSHOT_FILE_VERSION;
+        header.distance_bytes = sizeof(Distance);
+        header.node_level = node_level;
+        uint64_t position = snapshot_align(sizeof(SnapshotHeader));
+        for (size_t i = 0; i < SECTION_COUNT; ++i) {
+            header.section_offsets[i] = position;
+            header.section_bytes[i] = sections[i].second;
+            position = snapshot_align(position + sections[i].second);
+        }
+
+        // Concurrent writers of the same snapshot each use their own temporary file, and the last rename wins.
+        const std::string temporary_path = path + "." + std::to_string(getpid()) + ".tmp";
+        try {
+            {
+                MappedFile file(temporary_path, position);
+                char *data = file.mutable_data();
+                for (size_t i = 0; i < SECTION_COUNT; ++i) {
+                    if (sections[i].second > 0) {
+                        std::memcpy(data + header.section_offsets[i], sections[i].first, sections[i].second);
+                    }
+                }
+                header.checksum = snapshot_checksum(header, data + sizeof(header), position - sizeof(header));
+                std::memcpy(data, &header, sizeof(header));
+            }
+            if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+                throw std::runtime_error("Cannot rename " + temporary_path + " to " + path);
+            }
+        } catch (...) {
+            unlink(temporary_path.c_str());
+            throw;
+        }
+    }
+
+    // Maps a snapshot written by save() and returns a frozen graph whose arrays are used in place from the read-only
+    //  mapping, so loading costs no copies and the pages are shared with every other process mapping the same file.
+    //  verify=false skips the checksum pass over the whole file.
+    static std::unique_ptr<Graph> load(const std::string &path, const bool verify = true) {
+        std::unique_ptr<MappedFile> file(new MappedFile(path));
+        SnapshotHeader header;
+        if (file->size() < sizeof(header)) {
+            throw std::runtime_error("Not a graph snapshot: " + path);
+        }
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (header.magic != SNAPSHOT_FILE_MAGIC) {
+            throw std::runtime_error("Not a graph snapshot: " + path);
+        }
+        if (header.version != SNAPSHOT_FILE_VERSION) {
+            throw std::runtime_error("Unsupported graph snapshot version " + std::to_string(header.version) + " in " + path);
+        }
+        if (header.distance_bytes != sizeof(Distance)) {
+            throw std::runtime_error("Graph snapshot " + path + " was saved with " + std::to_string(8 * header.distance_bytes) + "-bit distances");
+        }
+        uint64_t end = sizeof(header);
+        for (size_t i = 0; i < SECTION_COUNT; ++i) {
+            if (header.section_offsets[i] % SNAPSHOT_ALIGNMENT != 0 || header.section_offsets[i] > file->size()
+                || header.section_bytes[i] > file->size() - header.section_offsets[i]) {
+                throw std::runtime_error("Truncated graph snapshot: " + path);
+            }
+            end = std::max(end, header.section_offsets[i] + header.section_bytes[i]);
+        }
+        end = std::min<uint64_t>(snapshot_align(end), file->size());
+        if (verify && snapshot_checksum(header, file->data() + sizeof(header), end - sizeof(header)) != header.checksum) {
+            throw std::runtime_error("Checksum mismatch in graph snapshot " + path);
+        }
+
+        std::unique_ptr<Graph> graph(new Graph());
+        snapshot_view(*file, header, SECTION_VERTEX_IPS, graph->vertex_ips);
+        snapshot_view(*file, header, SECTION_OFFSETS, graph->offsets);
+        snapshot_view(*file, header, SECTION_NEIGHBORS, graph->neighbors);
+        snapshot_view(*file, header, SECTION_POSITIONS, graph->positions);
+        snapshot_view(*file, header, SECTION_WEIGHTS, graph->weights);
+        snapshot_view(*file, header, SECTION_HIERARCHY_RANK, graph->hierarchy_rank);
+        snapshot_view(*file, header, SECTION_HIERARCHY_OFFSETS, graph->hierarchy_offsets);
+        snapshot_view(*file, header, SECTION_HIERARCHY_EDGES, graph->hierarchy_edges);
+        snapshot_view(*file, header, SECTION_ORACLE_OFFSETS, graph->oracle_offsets);
+        snapshot_view(*file, header, SECTION_ORACLE_LANDMARKS, graph->oracle_landmarks);
+        snapshot_view(*file, header, SECTION_ORACLE_DISTANCES, graph->oracle_distances);
+
+        const size_t count = graph->vertex_ips.size();
+        const bool consistent = graph->offsets.size() == count + 1 && graph->offsets.back() == graph->neighbors.size()
+            && (graph->positions.empty() || (graph->positions.size() == 3 * count && graph->weights.size() == graph->neighbors.size()))
+            && (graph->hierarchy_rank.empty() || (graph->hierarchy_rank.size() == count && graph->hierarchy_offsets.size() == count + 1
+                && graph->hierarchy_offsets.back() == graph->hierarchy_edges.size()))
+            && (graph->oracle_offsets.empty() || (graph->oracle_offsets.size() == count + 1
+                && graph->oracle_offsets.back() == graph->oracle_landmarks.size() && graph->oracle_landmarks.size() == graph->oracle_distances.size()));
+        if (!consistent) {
+            throw std::runtime_error("Inconsistent graph snapshot: " + path);
+        }
+
+        graph->node_level = header.node_level != 0;
+        graph->snapshot = std::move(file);
+        graph->frozen.store(true, std::memory_order_release);
+        return graph;
+    }
+
+    // Publishes the frozen graph under a name that other processes on this host attach() to, so that concurrent jobs
+    //  share a single copy of it in memory. The graph is kept as a snapshot in a memory file system and outlives
+    //  the process until unpublish().
+    void publish(const std::string &name) const {
+        save(shared_graph_path(name));
+    }
+
+    // Maps a graph published under name read-only. The checksum is skipped by default, since the segment was
+    //  written on this host and never left memory.
+    static std::unique_ptr<Graph> attach(const std::string &name, const bool verify = false) {
+        return load(shared_graph_path(name), verify);
+    }
+
+    static bool is_published(const std::string &name) {
+        return access(shared_graph_path(name).c_str(), F_OK) == 0;
+    }
+
+    // Removes a published graph. Processes already attached keep their mapping until they release the graph.
+    static void unpublish(const std::string &name) {
+        const std::string path = shared_graph_path(name);
+        if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+            throw std::runtime_error("Cannot remove shared graph " + path);
+        }
+    }
+
+    // Gives each NUMA node its own copy of the CSR and edge weights, allocated in the node's memory by copying them
+    //  from a thread pinned to its CPUs (unless numactl --membind says otherwise). Parallel queries then pin each
+    //  thread to one node, read that node's copy, and take sources from their own node's queue before the others'.
+    //  Returns the number of replicas, which is 0 on a single-node machine, where nothing changes. Like the other
+    //  updates, it fails while queries are running, so call it before handing the graph out for queries.
+    size_t replicate_per_numa_node() {
+        const std::vector<std::vector<int>> node_cpus = numa_node_cpus();
+        if (node_cpus.size() > 1) {
+            replicate_numa(node_cpus);
+        }
+        return numa_replicas.size();
+    }
+
+    // Same as replicate_per_numa_node(), for the given CPUs of each node.
+    void replicate_numa(const std::vector<std::vector<int>> &node_cpus) {
+        const UpdateScope update(*this);
+        std::vector<std::unique_ptr<Graph>> replicas;
+        for (const auto &cpus : node_cpus) {
+            if (cpus.empty()) {
+                throw std::invalid_argument("Every NUMA node needs at least one CPU");
+            }
+            const CpuPin pin(cpus);
+            std::unique_ptr<Graph> replica(new Graph());
+            replica->offsets = FrozenArray<size_t>(std::vector<size_t>(offsets.begin(), offsets.end()));
+            replica->neighbors = FrozenArray<unsigned int>(std::vector<unsigned int>(neighbors.begin(), neighbors.end()));
+            replica->weights = FrozenArray<float>(std::vector<float>(weights.begin(), weights.end()));
+            replica->frozen.store(true, std::memory_order_release);
+            replicas.push_back(std::move(replica));
+        }
+        numa_replicas.swap(replicas);
+        // Pooled workspaces were placed for the previous nodes.
+        workspace_pool.clear();
+        numa_cpus = node_cpus;
+        share_with_numa_replicas();
+    }
+
+    size_t vertex_count() const {
+        return frozen.load(std::memory_order_acquire) ? vertex_ips.size() : graph.size();
+    }
+
+    // A query on a frozen graph, counted for as long as it is in scope so that updates cannot start meanwhile.
+    class QueryScope {
+    public:
+        explicit QueryScope(const Graph &graph) : graph(graph) {
+            graph.require_frozen();
+            std::lock_guard<std::mutex> lock(graph.update_mutex);
+            if (graph.updating) {
+                throw std::logic_error("Graph is being updated; run queries after it returns");
+            }
+            ++graph.running_queries;
+        }
+
+        ~QueryScope() {
+            std::lock_guard<std::mutex> lock(graph.update_mutex);
+            --graph.running_queries;
+        }
+
+    private:
+        const Graph &graph;
+    };
+
+    // An update that replaces arrays of a frozen graph, which runs alone: no query may be running or start meanwhile.
+    class UpdateScope {
+    public:
+        explicit UpdateScope(Graph &graph) : graph(graph) {
+            graph.require_frozen();
+            std::lock_guard<std::mutex> lock(graph.update_mutex);
+            if (graph.updating || graph.running_queries > 0) {
+                throw std::logic_error("Graph cannot be updated while queries or another update are running");
+            }
+            graph.updating = true;
+        }
+
+        ~UpdateScope() {
+            std::lock_guard<std::mutex> lock(graph.update_mutex);
+            graph.updating = false;
+        }
+
+    private:
+        Graph &graph;
+    };
+
+    // Queries only read the CSR, which never changes once frozen, so they are safe to run concurrently.
+    void require_frozen() const {
+        if (!frozen.load(std::memory_order_acquire)) {
+            throw std::logic_error("Graph must be frozen with freeze() before running queries");
+        }
+    }
+
+    void require_coordinates() const {
+        if (positions.empty()) {
+            throw std::logic_error("Graph has no coordinates; call set_coordinates() before freeze()");
+        }
+    }
+
+    void require_hierarchy() const {
+        if (hierarchy_rank.empty()) {
+            throw std::logic_error("Graph has no contraction hierarchy; call build_contraction_hierarchy() or load_contraction_hierarchy() first");
+        }
+    }
+
+    void require_oracle() const {
+        if (oracle_offsets.empty()) {
+            throw std::logic_error("Graph has no distance oracle; call build_distance_oracle() or load_distance_oracle() first");
+        }
+    }
+
+    // Minimum over the landmarks shared by the two labels, found by merging them in rank order, or -1 if none.
+    int label_distance(const unsigned int &u, const unsigned int &v) const {
+        size_t i = oracle_offsets[u];
+        size_t j = oracle_offsets[v];
+        const size_t i_end = oracle_offsets[u + 1];
+        const size_t j_end = oracle_offsets[v + 1];
+        int best = -1;
+        while (i < i_end && j < j_end) {
+            if (oracle_landmarks[i] < oracle_landmarks[j]) {
+                ++i;
+            } else if (oracle_landmarks[i] > oracle_landmarks[j]) {
+                ++j;
+            } else {
+                const int distance = oracle_distances[i] + oracle_distances[j];
+                if (best < 0 || distance < best) {
+                    best = distance;
+                }
+                ++i;
+                ++j;
+            }
+        }
+        return best;
+    }
+
+    // Runs work(graph, workspace, k) for every k in [0, count) on all cores, handing out one item at a time, since
+    //  an unreachable source exhausts its whole component and costs orders of magnitude more than the others. Each
+    //  thread takes one Workspace from the pool when it takes its first item, reuses it for the rest and returns it
+    //  at the end, so threads left without items, e.g. with fewer items than threads, take none. graph is this
+    //  graph, or with NUMA replicas the replica of the node the thread is pinned to: the items are then split into
+    //  one queue per node in proportion to its threads, and a thread whose own queue runs dry takes items from the
+    //  other nodes' queues.
+    template <typename Workspace, typename Work>
+    void parallel_items(const size_t count, Work work) const {
+        if (numa_replicas.empty()) {
+            #pragma omp parallel
+            {
+                std::shared_ptr<Workspace> workspace;
+
+                #pragma omp for schedule(dynamic, 1)
+                for (size_t k = 0; k < count; ++k) {
+                    if (!workspace) {
+                        workspace = workspace_pool.acquire<Workspace>(0, vertex_ips.size());
+                    }
+                    work(*this, *workspace, k);
+                }
+                if (workspace) {
+                    workspace_pool.release(0, workspace);
+                }
+            }
+            return;
+        }
+
+        // Threads are spread over the nodes in proportion to their CPUs.
+        const size_t nodes = numa_replicas.size();
+        const size_t threads = omp_get_max_threads();
+        std::vector<size_t> cpu_nodes;
+        for (size_t n = 0; n < nodes; ++n) {
+            cpu_nodes.insert(cpu_nodes.end(), numa_cpus[n].size(), n);
+        }
+        std::vector<size_t> thread_nodes(threads);
+        std::vector<size_t> node_threads(nodes, 0);
+        for (size_t t = 0; t < threads; ++t) {
+            thread_nodes[t] = cpu_nodes[t * cpu_nodes.size() / threads];
+            ++node_threads[thread_nodes[t]];
+        }
+        std::unique_ptr<WorkQueue[]> queues(new WorkQueue[nodes]);
+        size_t queued_threads = 0;
+        for (size_t n = 0; n < nodes; ++n) {
+            queues[n].next = count * queued_threads / threads;
+            queued_threads += node_threads[n];
+            queues[n].end = count * queued_threads / threads;
+        }
+
+        #pragma omp parallel num_threads(threads)
+        {
+            const size_t node = thread_nodes[omp_get_thread_num()];
+            const CpuPin pin(numa_cpus[node]);
+            std::shared_ptr<Workspace> workspace;
+
+            for (size_t step = 0; step < nodes; ++step) {
+                WorkQueue &queue = queues[(node + step) % nodes];
+                for (size_t k = queue.next++; k < queue.end; k = queue.next++) {
+                    if (!workspace) {
+                        workspace = workspace_pool.acquire<Workspace>(node, vertex_ips.size());
+                    }
+                    work(*numa_replicas[node], *workspace, k);
+                }
+            }
+            if (workspace) {
+                workspace_pool.release(node, workspace);
+            }
+        }
+    }
+
+    // Points the replicas at the arrays that are not copied per node, whenever those are built or loaded.
+    void share_with_numa_replicas() {
+        for (const auto &replica : numa_replicas) {
+            replica->vertex_ips = vertex_ips.view();
+            replica->positions = positions.view();
+            replica->hierarchy_rank = hierarchy_rank.view();
+            replica->hierarchy_offsets = hierarchy_offsets.view();
+            replica->hierarchy_edges = hierarchy_edges.view();
+            replica->oracle_offsets = oracle_offsets.view();
+            replica->oracle_landmarks = oracle_landmarks.view();
+            replica->oracle_distances = oracle_distances.view();
+        }
+    }
+
+    // Parses a line of a links file, "link L<id>: <node>[:<ip>] ...", into the sorted distinct IPs of its nodes, or
+    //  the numbers of its nodes with IPs if node_level. Returns false if it is not a link line.
+    static bool parse_link(const char *p, const char *end, const NodeIPs &nodes, const bool node_level, std::vector<unsigned int> &interfaces) {
+        static const char prefix[] = "link L";
+        interfaces.clear();
+        if (end - p < static_cast<ptrdiff_t>(sizeof(prefix) - 1) || std::memcmp(p, prefix, sizeof(prefix) - 1) != 0) {
+            return false;
+        }
+        p += sizeof(prefix) - 1;
+        const char *digits = p;
+        while (p != end && *p >= '0' && *p <= '9') {
+            ++p;
+        }
+        if (p == digits || p == end || *p++ != ':' || p == end || *p != ' ') {
+            return false;
+        }
+        // The routers are the space-separated words up to the first character outside [N0-9.: ], each a node ID
+        //  optionally followed by the IP of its interface, which is ignored in favor of all of the node's IPs.
+        while (p != end) {
+            while (p != end && *p == ' ') {
+                ++p;
+            }
+            const char *word = p;
+            while (p != end && (*p == 'N' || *p == '.' || *p == ':' || (*p >= '0' && *p <= '9'))) {
+                ++p;
+            }
+            if (p == word) {
+                break;
+            }
+            const char *colon = static_cast<const char *>(std::memchr(word, ':', p - word));
+            size_t node;
+            if (!parse_node_id(word, colon ? colon : p, node) || node >= nodes.node_count()) {
+                continue;
+            }
+            if (!node_level) {
+                interfaces.insert(interfaces.end(), nodes.ips.begin() + nodes.offsets[node], nodes.ips.begin() + nodes.offsets[node + 1]);
+            } else if (nodes.offsets[node] < nodes.offsets[node + 1]) {
+                interfaces.push_back(node);
+            }
+        }
+        std::sort(interfaces.begin(), interfaces.end());
+        interfaces.erase(std::unique(interfaces.begin(), interfaces.end()), interfaces.end());
+        return true;
+    }
+
+    static size_t vertex_shard(const unsigned int &ip, const size_t &shards) {
+        return (ip * 0x9e3779b1u) % shards;
+    }
+
+    // Returns the index of the vertex with the given IP in the CSR layout, or NO_VERTEX if not found.
+    unsigned int vertex_index(const unsigned int &ip) const {
+        auto it = std::lower_bound(vertex_ips.begin(), vertex_ips.end(), ip);
+        if (it == vertex_ips.end() || *it != ip) {
+            return NO_VERTEX;
+        }
+        return it - vertex_ips.begin();
+    }
+
+    // A bare name is a POSIX shared-memory segment, and a name with a slash is a file used as is, for example on a
+    //  hugetlbfs mount to back the graph with huge pages.
+    static std::string shared_graph_path(const std::string &name) {
+        return name.find('/') == std::string::npos ? "/dev/shm/" + name : name;
+    }
+
+    static uint64_t snapshot_align(const uint64_t bytes) {
+        return (bytes + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    }
+
+    template <typename T>
+    static std::pair<const char *, size_t> snapshot_section(const FrozenArray<T> &array) {
+        return std::make_pair(reinterpret_cast<const char *>(array.data()), array.size() * sizeof(T));
+    }
+
+    template <typename T>
+    static void snapshot_view(const MappedFile &file, const SnapshotHeader &header, const SnapshotSection section, FrozenArray<T> &array) {
+        if (header.section_bytes[section] % sizeof(T) != 0) {
+            throw std::runtime_error("Inconsistent graph snapshot section " + std::to_string(section));
+        }
+        const T *data = reinterpret_cast<const T *>(file.data() + header.section_offsets[section]);
+        array = FrozenArray<T>(data, header.section_bytes[section] / sizeof(T));
+    }
+
+    // Checksum of a snapshot: the hash of its header, with the checksum field zeroed, combined with that of the
+    //  size bytes of sections that follow it.
+    static uint64_t snapshot_checksum(const SnapshotHeader &header, const char *sections, const size_t size) {
+        SnapshotHeader unchecked = header;
+        unchecked.checksum = 0;
+        uint64_t checksum = hash_bytes(reinterpret_cast<const char *>(&unchecked), sizeof(unchecked));
+        checksum = (checksum ^ hash_bytes(sections, size)) * 0x9e3779b97f4a7c15ULL;
+        return checksum ^ (checksum >> 29);
+    }
+
+    // Hash of size bytes. Each 1 MiB chunk is hashed word by word on its own thread, and the chunk hashes are
+    //  combined in order, so the result does not depend on the thread count.
+    static uint64_t hash_bytes(const char *data, const size_t size) {
+        const size_t chunk_bytes = 1 << 20;
+        const size_t chunks = (size + chunk_bytes - 1) / chunk_bytes;
+        std::vector<uint64_t> chunk_hashes(chunks);
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t c = 0; c < chunks; ++c) {
+            const size_t begin = c * chunk_bytes;
+            const size_t end = std::min(size, begin + chunk_bytes);
+            uint64_t hash = 0xcbf29ce484222325ULL ^ c;
+            for (size_t i = begin; i < end; i += sizeof(uint64_t)) {
+                uint64_t word = 0;
+                std::memcpy(&word, data + i, std::min(end - i, sizeof(uint64_t)));
+                hash = (hash ^ word) * 0x100000001b3ULL;
+                hash ^= hash >> 32;
+            }
+            chunk_hashes[c] = hash;
+        }
+        uint64_t checksum = size;
+        for (size_t c = 0; c < chunks; ++c) {
+            checksum = (checksum ^ chunk_hashes[c]) * 0x9e3779b97f4a7c15ULL;
+            checksum ^= checksum >> 29;
+        }
+        return checksum;
+    }
+
+    // A batch of per-source searches: routes from every IP in src_ips to destinations, written into paths.
+    struct SearchTask {
+        const std::vector<unsigned int> *src_ips;
+        const Endpoints *destinations;
+        std::vector<std::vector<unsigned int>> *paths;
+    };
+
+    // Runs search(graph, workspace, src_ip, destinations) for every source of every task on all cores, with the
+    //  graph and workspace of parallel_items(). Sources are handed out one at a time across all tasks, and each
+    //  thread writes its results straight into their slots, so no lock is needed and the paths of each task follow
+    //  the order of its src_ips.
+    template <typename Workspace, typename Search>
+    void parallel_search(const std::vector<SearchTask> &tasks, Search search) const {
+        std::vector<std::pair<size_t, size_t>> items;
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            tasks[t].paths->assign(tasks[t].src_ips->size(), std::vector<unsigned int>());
+            for (size_t i = 0; i < tasks[t].src_ips->size(); ++i) {
+                items.push_back(std::make_pair(t, i));
+            }
+        }
+        std::atomic<size_t> completed(0);
+        parallel_items<Workspace>(items.size(), [&](const Graph &graph, Workspace &workspace, const size_t k) {
+            const SearchTask &task = tasks[items[k].first];
+            const size_t i = items[k].second;
+            (*task.paths)[i] = search(graph, workspace, (*task.src_ips)[i], *task.destinations);
+            report_progress(++completed, items.size());
+        });
+    }
+
+    template <typename Workspace, typename Search>
+    std::vector<std::vector<unsigned int>> parallel_search(const std::vector<unsigned int>& src_ips, const Endpoints &destinations, Search search) const {
+        std::vector<std::vector<unsigned int>> results;
+        SearchTask task;
+        task.src_ips = &src_ips;
+        task.destinations = &destinations;
+        task.paths = &results;
+        parallel_search<Workspace>(std::vector<SearchTask>(1, task), search);
+        return results;
+    }
+
+    static void report_progress(const size_t &completed, const size_t &total) {
+        // Format the whole line first, so that lines from different threads don't interleave.
+        std::ostringstream line;
+        line << "Progress: " << completed << "/" << total << "\n";
+        std::cerr << line.str();
+    }
+
+    // Runs multi_target_bfs() for every source of every group on all cores, handing out one source at a time.
+    //  paths[g][l] receives the paths from source group g to label l, one per source, or is nullptr to drop them.
+    void parallel_multi_target(const std::vector<const std::vector<unsigned int> *> &src_groups, const LabelledEndpoints &destinations, const size_t max_hops,
+                               const std::vector<std::vector<std::vector<std::vector<unsigned int>> *>> &paths) const {
+        std::vector<std::pair<size_t, size_t>> items;
+        for (size_t g = 0; g < src_groups.size(); ++g) {
+            for (const auto &label_paths : paths[g]) {
+                if (label_paths) {
+                    label_paths->assign(src_groups[g]->size(), std::vector<unsigned int>());
+                }
+            }
+            for (size_t i = 0; i < src_groups[g]->size(); ++i) {
+                items.push_back(std::make_pair(g, i));
+            }
+        }
+        std::atomic<size_t> completed(0);
+        parallel_items<SearchWorkspace>(items.size(), [&](const Graph &graph, SearchWorkspace &workspace, const size_t k) {
+            const size_t g = items[k].first;
+            const size_t i = items[k].second;
+            auto source_paths = graph.multi_target_bfs(workspace, (*src_groups[g])[i], destinations, max_hops);
+            for (size_t l = 0; l < source_paths.size(); ++l) {
+                if (paths[g][l]) {
+                    (*paths[g][l])[i] = std::move(source_paths[l]);
+                }
+            }
+            report_progress(++completed, items.size());
+        });
+    }
+
+    Endpoints endpoints(const std::set<unsigned int> &ips) const {
+        Endpoints result;
+        result.ips = ips;
+        result.vertices = VertexSet(vertex_ips.size());
+        for (const auto &ip : ips) {
+            const unsigned int index = vertex_index(ip);
+            if (index != NO_VERTEX) {
+                result.indices.push_back(index);
+                result.vertices.insert(index);
+            }
+        }
+        return result;
+    }
+
+    LabelledEndpoints labelled_endpoints(const LabelledIPs &groups) const {
+        LabelledEndpoints result;
+        result.vertices = VertexSet(vertex_ips.size());
+        for (const auto &group : groups) {
+            result.labels.push_back(group.first);
+            result.endpoints.push_back(endpoints(std::set<unsigned int>(group.second.begin(), group.second.end())));
+            for (const auto &index : result.endpoints.back().indices) {
+                result.vertex_labels.push_back(std::make_pair(index, result.labels.size() - 1));
+                result.vertices.insert(index);
+            }
+        }
+        std::sort(result.vertex_labels.begin(), result.vertex_labels.end());
+        return result;
+    }
+
+    std::vector<unsigned int> to_ips(const std::vector<unsigned int> &path) const {
+        std::vector<unsigned int> ips;
+        ips.reserve(path.size());
+        for (const auto &index : path) {
+            ips.push_back(vertex_ips[index]);
+        }
+        return ips;
+    }
+
+    std::vector<unsigned int> dijkstra(const unsigned int &start, const std::set<unsigned int> &destinations) const {
+        const QueryScope query(*this);
+        const std::shared_ptr<SearchWorkspace> workspace = workspace_pool.acquire<SearchWorkspace>(0, vertex_ips.size());
+        std::vector<unsigned int> path = dijkstra(*workspace, start, endpoints(destinations));
+        workspace_pool.release(0, workspace);
+        return path;
+    }
+
+    std::vector<unsigned int> dijkstra(SearchWorkspace &workspace, const unsigned int &start, const Endpoints &destinations, const size_t max_hops = 0) const {
+        if (destinations.has_ip(start)) {
+            return {start};
+        }
+
+        const unsigned int start_index = vertex_index(start);
+        if (start_index == NO_VERTEX) {
+            return {};
+        }
+        return to_ips(dijkstra_by_index(workspace, start_index, destinations.vertices, max_hops));
+    }
+
+    // Dijkstra over vertex indices. A vertex without the current epoch stamp has infinite distance. Vertices at
+    //  max_hops, or at MAX_DISTANCE, are not expanded.
+    std::vector<unsigned int> dijkstra_by_index(SearchWorkspace &workspace, const unsigned int &start, const VertexSet &is_destination, const size_t max_hops = 0) const {
+        const size_t hop_limit = max_hops == 0 || max_hops > MAX_DISTANCE ? MAX_DISTANCE : max_hops;
+        const std::greater<SearchWorkspace::HeapEntry> min_heap_order;
+        std::vector<SearchWorkspace::HeapEntry> &min_heap = workspace.heap;
+        workspace.reset();
+        workspace.visit(start, NO_VERTEX);
+        workspace.distance[start] = 0;
+        unsigned int current_node = start;
+
+        min_heap.push_back(std::make_tuple(0, start));
+
+        while (!min_heap.empty()) {
+            std::pop_heap(min_heap.begin(), min_heap.end(), min_heap_order);
+            std::tie(std::ignore, current_node) = min_heap.back();
+            min_heap.pop_back();
+
+            if (is_destination[current_node]) {
+                break;
+            }
+            if (static_cast<size_t>(workspace.distance[current_node]) >= hop_limit) {
+                continue;
+            }
+
+            for (size_t j = offsets[current_node]; j < offsets[current_node + 1]; ++j) {
+                const unsigned int neighbor = neighbors[j];
+                const Distance distance = workspace.distance[current_node] + 1;
+                if (!workspace.visited(neighbor) || distance < workspace.distance[neighbor]) {
+                    workspace.visit(neighbor, current_node);
+                    workspace.distance[neighbor] = distance;
+                    min_heap.push_back(std::make_tuple(distance, neighbor));
+                    std::push_heap(min_heap.begin(), min_heap.end(), min_heap_order);
+                }
+            }
+        }
+
+        if (!is_destination[current_node] || workspace.prev[current_node] == NO_VERTEX) {
+            return {};
+        }
+
+        std::vector<unsigned int> path;
+        while (current_node != start) {
+            path.push_back(current_node);
+            current_node = workspace.prev[current_node];
+        }
+        path.push_back(start);
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    std::vector<unsigned int> bfs(SearchWorkspace &workspace, const unsigned int &start, const Endpoints &destinations, const size_t max_hops = 0) const {
+        if (destinations.has_ip(start)) {
+            return {start};
+        }
+
+        const unsigned int start_index = vertex_index(start);
+        if (start_index == NO_VERTEX) {
+            return {};
+        }
+        return to_ips(bfs_by_index(workspace, start_index, destinations.vertices, max_hops));
+    }
+
+    // Reverse multi-source BFS behind reverseBFS(): grows one forest from all destinations until every source in
+    //  `sources` is reached, then walks each source's parents up to its root.
+    std::vector<std::vector<unsigned int>> reverse_bfs(SearchWorkspace &workspace, const std::vector<unsigned int>& src_ips, const Endpoints &sources, const Endpoints &destinations,
+                                                       const size_t max_hops = 0) const {
+        size_t remaining_sources = sources.indices.size();
+        workspace.reset();
+        for (const auto &index : destinations.indices) {
+            workspace.visit(index, index);
+            workspace.frontier.push_back(index);
+            if (sources.vertices[index]) {
+                --remaining_sources;
+            }
+        }
+
+        if (remaining_sources > 0) {
+            bfs_levels(workspace, [&](const unsigned int &vertex) {
+                if (sources.vertices[vertex]) {
+                    --remaining_sources;
+                }
+                return remaining_sources == 0;
+            }, max_hops);
+        }
+
+        std::vector<std::vector<unsigned int>> results(src_ips.size());
+        for (size_t i = 0; i < src_ips.size(); ++i) {
+            if (destinations.has_ip(src_ips[i])) {
+                results[i] = {src_ips[i]};
+                continue;
+            }
+            unsigned int current_node = vertex_index(src_ips[i]);
+            if (current_node == NO_VERTEX || !workspace.visited(current_node)) {
+                continue;
+            }
+            results[i].push_back(vertex_ips[current_node]);
+            while (workspace.prev[current_node] != current_node) {
+                current_node = workspace.prev[current_node];
+                results[i].push_back(vertex_ips[current_node]);
+            }
+        }
+        return results;
+    }
+
+    // Level-synchronous BFS over vertex indices. All edges have unit weight, so every vertex is visited once.
+    //  Each frontier is scanned in ascending index order, which picks the same parents and the same destination
+    //  as dijkstra_by_index(): the lowest-index parent in the previous level, and the lowest-index destination in
+    //  the first level that contains one.
+    std::vector<unsigned int> bfs_by_index(SearchWorkspace &workspace, const unsigned int &start, const VertexSet &is_destination, const size_t max_hops = 0) const {
+        workspace.reset();
+        workspace.visit(start, start);
+        workspace.frontier.push_back(start);
+        unsigned int found = NO_VERTEX;
+
+        bfs_levels(workspace, [&](const unsigned int &vertex) {
+            if (is_destination[vertex] && vertex < found) {
+                found = vertex;
+            }
+            return found != NO_VERTEX;
+        }, max_hops);
+
+        if (found == NO_VERTEX) {
+            return {};
+        }
+
+        std::vector<unsigned int> path;
+        for (unsigned int current_node = found; current_node != start; current_node = workspace.prev[current_node]) {
+            path.push_back(current_node);
+        }
+        path.push_back(start);
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    std::vector<std::vector<unsigned int>> vertices_within(SearchWorkspace &workspace, const unsigned int &start, const size_t radius) const {
+        const unsigned int start_index = vertex_index(start);
+        if (start_index == NO_VERTEX) {
+            return {};
+        }
+
+        std::vector<std::vector<unsigned int>> levels(1, std::vector<unsigned int>(1, start));
+        if (radius == 0) {
+            return levels;
+        }
+
+        std::vector<Distance> &distance = workspace.distance;
+        workspace.reset();
+        workspace.visit(start_index, start_index);
+        workspace.frontier.push_back(start_index);
+        distance[start_index] = 0;
+        bfs_levels(workspace, [&](const unsigned int &vertex) {
+            distance[vertex] = distance[workspace.prev[vertex]] + 1;
+            if (levels.size() <= static_cast<size_t>(distance[vertex])) {
+                levels.emplace_back();
+            }
+            levels.back().push_back(vertex_ips[vertex]);
+            return false;
+        }, radius);
+        return levels;
+    }
+
+    std::vector<std::vector<unsigned int>> k_shortest_paths(SearchWorkspace &workspace, const unsigned int &start, const Endpoints &destinations, const size_t k) const {
+        if (k == 0) {
+            return {};
+        }
+        if (destinations.has_ip(start)) {
+            return {{start}};
+        }
 
-    std::vector<std::vector<unsigned int>> parallelDijkstra(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations) {
-        std::vector<std::vector<unsigned int>> results;
-        results.reserve(src_ips.size());
+        const unsigned int start_index = vertex_index(start);
+        if (start_index == NO_VERTEX) {
+            return {};
+        }
 
-        #pragma omp parallel for
-        for (unsigned long int i = 0; i < src_ips.size(); ++i) {
-            auto result = dijkstra(src_ips[i], destinations);
-            #pragma omp critical
-            {
-                results.emplace_back(std::move(result));
-                std::cerr << "Progress: " << results.size() << "/" << src_ips.size() << std::endl;
+        std::vector<std::vector<unsigned int>> accepted;
+        std::vector<unsigned int> shortest = bfs_by_index(workspace, start_index, destinations.vertices);
+        if (shortest.empty()) {
+            return {};
+        }
+        accepted.push_back(shortest);
+
+        // Candidates ordered by hop count, then by vertex index, which is IP order.
+        std::set<std::pair<size_t, std::vector<unsigned int>>> candidates;
+        std::vector<unsigned int> blocked_neighbors;
+        while (accepted.size() < k) {
+            const std::vector<unsigned int> &previous = accepted.back();
+            // Deviate from the previous path at each of its vertices but the destination, without revisiting the
+            //  root before the deviation and without reusing the next hop of any accepted path with the same root.
+            for (size_t i = 0; i + 1 < previous.size(); ++i) {
+                blocked_neighbors.clear();
+                for (const auto &path : accepted) {
+                    if (path.size() > i + 1 && std::equal(previous.begin(), previous.begin() + i + 1, path.begin())) {
+                        blocked_neighbors.push_back(path[i + 1]);
+                    }
+                }
+                std::sort(blocked_neighbors.begin(), blocked_neighbors.end());
+
+                std::vector<unsigned int> spur = spur_bfs(workspace, previous, i, blocked_neighbors, destinations.vertices);
+                if (spur.empty()) {
+                    continue;
+                }
+                std::vector<unsigned int> candidate(previous.begin(), previous.begin() + i);
+                candidate.insert(candidate.end(), spur.begin(), spur.end());
+                candidates.insert(std::make_pair(candidate.size(), candidate));
+            }
+
+            if (candidates.empty()) {
+                break;
             }
+            accepted.push_back(candidates.begin()->second);
+            candidates.erase(candidates.begin());
         }
-        return results;
+
+        for (auto &path : accepted) {
+            path = to_ips(path);
+        }
+        return accepted;
     }
 
-    void reserve(const size_t size) {
-        graph.reserve(size);
+    // BFS from root[spur] to the nearest destination that avoids root[0, spur) and the edges from root[spur] to
+    //  blocked_neighbors (sorted). Returns the path in vertex indices, starting at root[spur], or empty if none.
+    std::vector<unsigned int> spur_bfs(SearchWorkspace &workspace, const std::vector<unsigned int> &root, const size_t spur, const std::vector<unsigned int> &blocked_neighbors,
+                                       const VertexSet &is_destination) const {
+        const unsigned int start = root[spur];
+        workspace.reset();
+        for (size_t i = 0; i < spur; ++i) {
+            workspace.visit(root[i], root[i]);
+        }
+        workspace.visit(start, start);
+
+        // Expand the spur vertex by hand, so its blocked edges are skipped but their ends stay reachable.
+        unsigned int found = NO_VERTEX;
+        for (size_t j = offsets[start]; j < offsets[start + 1]; ++j) {
+            const unsigned int neighbor = neighbors[j];
+            if (workspace.visited(neighbor) || std::binary_search(blocked_neighbors.begin(), blocked_neighbors.end(), neighbor)) {
+                continue;
+            }
+            workspace.visit(neighbor, start);
+            workspace.frontier.push_back(neighbor);
+            if (is_destination[neighbor] && neighbor < found) {
+                found = neighbor;
+            }
+        }
+        if (found == NO_VERTEX) {
+            bfs_levels(workspace, [&](const unsigned int &vertex) {
+                if (is_destination[vertex] && vertex < found) {
+                    found = vertex;
+                }
+                return found != NO_VERTEX;
+            });
+        }
+
+        if (found == NO_VERTEX) {
+            return {};
+        }
+
+        std::vector<unsigned int> path;
+        for (unsigned int current_node = found; current_node != start; current_node = workspace.prev[current_node]) {
+            path.push_back(current_node);
+        }
+        path.push_back(start);
+        std::reverse(path.begin(), path.end());
+        return path;
     }
 
-    void add_edge(const unsigned int &u, const unsigned int &v) {
-        graph[u].insert(v);
-        graph[v].insert(u);
+    // A* over vertex indices with edge weights in km. Every vertex gets its estimate once, when first reached, and
+    //  a heap entry is stale when a shorter route to its vertex has been pushed since. The estimate is consistent,
+    //  so the first destination popped ends the search with a shortest route; ties go to the lowest index.
+    std::vector<unsigned int> astar(AStarWorkspace &workspace, const unsigned int &start, const Endpoints &destinations, const std::vector<double> &target_positions) const {
+        if (destinations.has_ip(start)) {
+            return {start};
+        }
+
+        const unsigned int start_index = vertex_index(start);
+        if (start_index == NO_VERTEX || target_positions.empty()) {
+            return {};
+        }
+
+        const std::greater<AStarWorkspace::HeapEntry> min_heap_order;
+        std::vector<AStarWorkspace::HeapEntry> &min_heap = workspace.heap;
+        SearchWorkspace &search = workspace.search;
+        search.reset();
+        min_heap.clear();
+        search.visit(start_index, start_index);
+        workspace.cost[start_index] = 0;
+        workspace.estimate[start_index] = nearest_km(start_index, target_positions);
+        min_heap.push_back(std::make_pair(workspace.estimate[start_index], start_index));
+
+        unsigned int found = NO_VERTEX;
+        while (!min_heap.empty()) {
+            std::pop_heap(min_heap.begin(), min_heap.end(), min_heap_order);
+            const AStarWorkspace::HeapEntry entry = min_heap.back();
+            min_heap.pop_back();
+            const unsigned int current_node = entry.second;
+            if (entry.first > workspace.cost[current_node] + workspace.estimate[current_node]) {
+                continue;
+            }
+            if (destinations.vertices[current_node]) {
+                found = current_node;
+                break;
+            }
+
+            for (size_t j = offsets[current_node]; j < offsets[current_node + 1]; ++j) {
+                const unsigned int neighbor = neighbors[j];
+                const double cost = workspace.cost[current_node] + weights[j];
+                if (!search.visited(neighbor)) {
+                    workspace.estimate[neighbor] = nearest_km(neighbor, target_positions);
+                } else if (cost >= workspace.cost[neighbor]) {
+                    continue;
+                }
+                search.visit(neighbor, current_node);
+                workspace.cost[neighbor] = cost;
+                min_heap.push_back(std::make_pair(cost + workspace.estimate[neighbor], neighbor));
+                std::push_heap(min_heap.begin(), min_heap.end(), min_heap_order);
+            }
+        }
+
+        if (found == NO_VERTEX) {
+            return {};
+        }
+
+        std::vector<unsigned int> path;
+        for (unsigned int current_node = found; current_node != start_index; current_node = search.prev[current_node]) {
+            path.push_back(vertex_ips[current_node]);
+        }
+        path.push_back(start);
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // Finds the shortcuts that contracting vertex would need: for every pair of its remaining neighbors (u, w),
+    //  unless a witness search from u that avoids vertex reaches w in at most weight(u, vertex, w).
+    void find_shortcuts(AStarWorkspace &workspace, const std::vector<std::vector<ShortcutEdge>> &remaining, const unsigned int &vertex,
+                        std::vector<std::pair<unsigned int, ShortcutEdge>> &shortcuts) const {
+        shortcuts.clear();
+        const std::vector<ShortcutEdge> &edges = remaining[vertex];
+        double max_weight = 0;
+        for (const auto &edge : edges) {
+            max_weight = std::max(max_weight, edge.weight);
+        }
+
+        const std::greater<AStarWorkspace::HeapEntry> min_heap_order;
+        std::vector<AStarWorkspace::HeapEntry> &min_heap = workspace.heap;
+        SearchWorkspace &search = workspace.search;
+        for (size_t a = 0; a + 1 < edges.size(); ++a) {
+            const unsigned int source = edges[a].target;
+            const double limit = edges[a].weight + max_weight;
+            search.reset();
+            min_heap.clear();
+            search.visit(vertex, vertex);
+            workspace.cost[vertex] = 0;
+            search.visit(source, source);
+            workspace.cost[source] = 0;
+            min_heap.push_back(std::make_pair(0.0, source));
+
+            for (size_t settled = 0; !min_heap.empty() && settled < WITNESS_SETTLE_LIMIT; ++settled) {
+                std::pop_heap(min_heap.begin(), min_heap.end(), min_heap_order);
+                const AStarWorkspace::HeapEntry entry = min_heap.back();
+                min_heap.pop_back();
+                if (entry.first > workspace.cost[entry.second]) {
+                    continue;
+                }
+                if (entry.first > limit) {
+                    break;
+                }
+                for (const auto &edge : remaining[entry.second]) {
+                    const double cost = entry.first + edge.weight;
+                    if (search.visited(edge.target) && cost >= workspace.cost[edge.target]) {
+                        continue;
+                    }
+                    search.visit(edge.target, entry.second);
+                    workspace.cost[edge.target] = cost;
+                    min_heap.push_back(std::make_pair(cost, edge.target));
+                    std::push_heap(min_heap.begin(), min_heap.end(), min_heap_order);
+                }
+            }
+
+            for (size_t b = a + 1; b < edges.size(); ++b) {
+                const double via = edges[a].weight + edges[b].weight;
+                if (search.visited(edges[b].target) && workspace.cost[edges[b].target] <= via) {
+                    continue;
+                }
+                ShortcutEdge shortcut = { edges[b].target, vertex, via };
+                shortcuts.push_back(std::make_pair(source, shortcut));
+            }
+        }
+    }
+
+    static int64_t edge_difference(const std::vector<std::vector<ShortcutEdge>> &remaining, const std::vector<unsigned int> &contracted_neighbors, const unsigned int &vertex,
+                                   const std::vector<std::pair<unsigned int, ShortcutEdge>> &shortcuts) {
+        return static_cast<int64_t>(shortcuts.size()) - static_cast<int64_t>(remaining[vertex].size()) + contracted_neighbors[vertex];
+    }
+
+    // Adds a shortcut to an adjacency list, or shortens the existing edge to the same vertex.
+    static void add_shortcut(std::vector<ShortcutEdge> &edges, const ShortcutEdge &shortcut) {
+        for (auto &edge : edges) {
+            if (edge.target == shortcut.target) {
+                if (shortcut.weight < edge.weight) {
+                    edge = shortcut;
+                }
+                return;
+            }
+        }
+        edges.push_back(shortcut);
+    }
+
+    // Dijkstra over the upward edges of the hierarchy from all destinations, run to completion.
+    UpwardSearchSpace upward_search(const Endpoints &destinations) const {
+        UpwardSearchSpace settled;
+        typedef std::tuple<double, unsigned int, unsigned int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        for (const auto &index : destinations.indices) {
+            queue.push(std::make_tuple(0.0, index, index));
+        }
+        while (!queue.empty()) {
+            const Entry entry = queue.top();
+            queue.pop();
+            const unsigned int vertex = std::get<1>(entry);
+            if (!settled.insert(std::make_pair(vertex, std::make_pair(std::get<0>(entry), std::get<2>(entry)))).second) {
+                continue;
+            }
+            for (size_t j = hierarchy_offsets[vertex]; j < hierarchy_offsets[vertex + 1]; ++j) {
+                if (settled.find(hierarchy_edges[j].target) == settled.end()) {
+                    queue.push(std::make_tuple(std::get<0>(entry) + hierarchy_edges[j].weight, hierarchy_edges[j].target, vertex));
+                }
+            }
+        }
+        return settled;
     }
 
-    std::vector<unsigned int> dijkstra(const unsigned int &start, const std::set<unsigned int> &destinations) {
-        if (destinations.find(start) != destinations.end()) {
+    std::vector<unsigned int> ch_search(AStarWorkspace &workspace, const unsigned int &start, const Endpoints &destinations, const UpwardSearchSpace &backward) const {
+        if (destinations.has_ip(start)) {
             return {start};
         }
 
-        std::priority_queue<std::tuple<int_fast8_t, unsigned int>, std::vector<std::tuple<int_fast8_t, unsigned int>>, std::greater<std::tuple<int_fast8_t, unsigned int>>> min_heap;
-        std::unordered_map<unsigned int, int_fast8_t> distances;
-        distances.reserve(graph.size());
-        for (const auto &pair : graph) {
-            distances[pair.first] = INT_FAST8_MAX;
+        const unsigned int start_index = vertex_index(start);
+        if (start_index == NO_VERTEX) {
+            return {};
         }
-        distances[start] = 0;
-        std::unordered_map<unsigned int, unsigned int> prev;
-        unsigned int current_node = start;
 
-        min_heap.push(std::make_tuple(0, start));
+        const std::greater<AStarWorkspace::HeapEntry> min_heap_order;
+        std::vector<AStarWorkspace::HeapEntry> &min_heap = workspace.heap;
+        SearchWorkspace &search = workspace.search;
+        search.reset();
+        min_heap.clear();
+        search.visit(start_index, start_index);
+        workspace.cost[start_index] = 0;
+        min_heap.push_back(std::make_pair(0.0, start_index));
 
+        double best = std::numeric_limits<double>::infinity();
+        unsigned int meeting = NO_VERTEX;
         while (!min_heap.empty()) {
-            std::tie(std::ignore, current_node) = min_heap.top();
-            min_heap.pop();
+            std::pop_heap(min_heap.begin(), min_heap.end(), min_heap_order);
+            const AStarWorkspace::HeapEntry entry = min_heap.back();
+            min_heap.pop_back();
+            if (entry.first >= best) {
+                break;
+            }
+            const unsigned int current_node = entry.second;
+            if (entry.first > workspace.cost[current_node]) {
+                continue;
+            }
+            auto it = backward.find(current_node);
+            if (it != backward.end() && entry.first + it->second.first < best) {
+                best = entry.first + it->second.first;
+                meeting = current_node;
+            }
+
+            for (size_t j = hierarchy_offsets[current_node]; j < hierarchy_offsets[current_node + 1]; ++j) {
+                const ShortcutEdge &edge = hierarchy_edges[j];
+                const double cost = entry.first + edge.weight;
+                if (search.visited(edge.target) && cost >= workspace.cost[edge.target]) {
+                    continue;
+                }
+                search.visit(edge.target, current_node);
+                workspace.cost[edge.target] = cost;
+                min_heap.push_back(std::make_pair(cost, edge.target));
+                std::push_heap(min_heap.begin(), min_heap.end(), min_heap_order);
+            }
+        }
+
+        if (meeting == NO_VERTEX) {
+            return {};
+        }
 
-            if (destinations.find(current_node) != destinations.end()) {
+        // Hierarchy route: up from the start to the meeting vertex, then down to a destination.
+        std::vector<unsigned int> route;
+        for (unsigned int current_node = meeting; current_node != start_index; current_node = search.prev[current_node]) {
+            route.push_back(current_node);
+        }
+        route.push_back(start_index);
+        std::reverse(route.begin(), route.end());
+        for (unsigned int current_node = meeting; ; ) {
+            const unsigned int parent = backward.find(current_node)->second.second;
+            if (parent == current_node) {
                 break;
             }
+            route.push_back(parent);
+            current_node = parent;
+        }
+
+        std::vector<unsigned int> walk(1, start_index);
+        for (size_t k = 0; k + 1 < route.size(); ++k) {
+            unpack_shortcut(route[k], route[k + 1], walk);
+        }
+
+        // Co-located routers are joined by 0 km edges, so the unpacked walk can return to a vertex through a loop
+        //  of length 0; cutting such loops keeps the length and makes the path simple.
+        std::vector<unsigned int> path;
+        std::unordered_map<unsigned int, size_t> position;
+        for (const auto &vertex : walk) {
+            auto it = position.find(vertex);
+            if (it != position.end()) {
+                for (size_t k = it->second + 1; k < path.size(); ++k) {
+                    position.erase(path[k]);
+                }
+                path.resize(it->second + 1);
+                continue;
+            }
+            position[vertex] = path.size();
+            path.push_back(vertex);
+        }
+        return to_ips(path);
+    }
+
+    // Appends the vertices after `from` up to `to` on the graph route that the hierarchy edge between them stands for.
+    void unpack_shortcut(const unsigned int &from, const unsigned int &to, std::vector<unsigned int> &path) const {
+        const bool upward = hierarchy_rank[from] < hierarchy_rank[to];
+        const unsigned int lower = upward ? from : to;
+        const unsigned int higher = upward ? to : from;
+        const ShortcutEdge *begin = hierarchy_edges.data() + hierarchy_offsets[lower];
+        const ShortcutEdge *end = hierarchy_edges.data() + hierarchy_offsets[lower + 1];
+        const ShortcutEdge *edge = std::lower_bound(begin, end, higher, [](const ShortcutEdge &edge, const unsigned int &target) {
+            return edge.target < target;
+        });
+        if (edge->middle == NO_VERTEX) {
+            path.push_back(to);
+            return;
+        }
+        const unsigned int middle = edge->middle;
+        unpack_shortcut(from, middle, path);
+        unpack_shortcut(middle, to, path);
+    }
+
+    // The distinct unit-sphere positions of the destinations, 3 coordinates each, for nearest_km().
+    std::vector<double> unique_positions(const Endpoints &destinations) const {
+        std::set<std::tuple<double, double, double>> unique;
+        for (const auto &index : destinations.indices) {
+            unique.insert(std::make_tuple(positions[3 * index], positions[3 * index + 1], positions[3 * index + 2]));
+        }
+        std::vector<double> result;
+        for (const auto &position : unique) {
+            result.push_back(std::get<0>(position));
+            result.push_back(std::get<1>(position));
+            result.push_back(std::get<2>(position));
+        }
+        return result;
+    }
+
+    // A* heuristic: the great-circle km from vertex to the nearest of points, scaled by HEURISTIC_SCALE. The
+    //  nearest point on the sphere is the one with the largest dot product.
+    double nearest_km(const unsigned int &vertex, const std::vector<double> &points) const {
+        const double *position = &positions[3 * vertex];
+        double best_dot = -2;
+        size_t best = 0;
+        for (size_t k = 0; k < points.size(); k += 3) {
+            const double dot = position[0] * points[k] + position[1] * points[k + 1] + position[2] * points[k + 2];
+            if (dot > best_dot) {
+                best_dot = dot;
+                best = k;
+            }
+        }
+        return great_circle_km(position, &points[best]) * HEURISTIC_SCALE;
+    }
+
+    // Great-circle km between two unit vectors, from atan2 of the sine and cosine of their angle, which stays
+    //  accurate for the short distances between nearby routers where acos does not.
+    static double great_circle_km(const double *a, const double *b) {
+        const double cross_x = a[1] * b[2] - a[2] * b[1];
+        const double cross_y = a[2] * b[0] - a[0] * b[2];
+        const double cross_z = a[0] * b[1] - a[1] * b[0];
+        const double sine = std::sqrt(cross_x * cross_x + cross_y * cross_y + cross_z * cross_z);
+        const double cosine = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        return EARTH_RADIUS_KM * std::atan2(sine, cosine);
+    }
+
+    // BFS from `start` that records the first destination of every label it reaches, and stops once all labels
+    //  are found or after max_hops levels (0 for no limit). Returns one path per label, empty if not found.
+    std::vector<std::vector<unsigned int>> multi_target_bfs(SearchWorkspace &workspace, const unsigned int &start, const LabelledEndpoints &destinations, const size_t max_hops) const {
+        const size_t label_count = destinations.labels.size();
+        std::vector<std::vector<unsigned int>> paths(label_count);
+        std::vector<unsigned int> found(label_count, NO_VERTEX);
+        size_t remaining_labels = label_count;
+        for (size_t l = 0; l < label_count; ++l) {
+            if (destinations.endpoints[l].has_ip(start)) {
+                paths[l] = {start};
+                --remaining_labels;
+            } else if (destinations.endpoints[l].indices.empty()) {
+                // No IP of the label is in the graph, so the search cannot reach it and must not wait for it.
+                --remaining_labels;
+            }
+        }
+
+        const unsigned int start_index = vertex_index(start);
+        if (start_index == NO_VERTEX || remaining_labels == 0) {
+            return paths;
+        }
+
+        workspace.reset();
+        workspace.visit(start_index, start_index);
+        workspace.frontier.push_back(start_index);
+        bfs_levels(workspace, [&](const unsigned int &vertex) {
+            if (!destinations.vertices[vertex]) {
+                return false;
+            }
+            auto it = std::lower_bound(destinations.vertex_labels.begin(), destinations.vertex_labels.end(), std::make_pair(vertex, 0u));
+            for (; it != destinations.vertex_labels.end() && it->first == vertex; ++it) {
+                if (found[it->second] == NO_VERTEX && paths[it->second].empty()) {
+                    found[it->second] = vertex;
+                    --remaining_labels;
+                }
+            }
+            return remaining_labels == 0;
+        }, max_hops);
+
+        for (size_t l = 0; l < label_count; ++l) {
+            if (found[l] == NO_VERTEX) {
+                continue;
+            }
+            for (unsigned int current_node = found[l]; current_node != start_index; current_node = workspace.prev[current_node]) {
+                paths[l].push_back(vertex_ips[current_node]);
+            }
+            paths[l].push_back(start);
+            std::reverse(paths[l].begin(), paths[l].end());
+        }
+        return paths;
+    }
+
+    ECMPPaths ecmp(ECMPWorkspace &workspace, const unsigned int &start, const Endpoints &destinations, const size_t max_paths) const {
+        ECMPPaths result;
+        if (destinations.has_ip(start)) {
+            result.hops = 0;
+            result.path_count = 1;
+            result.vertex_fractions[start] = 1;
+            if (max_paths > 0) {
+                result.paths.push_back({start});
+            }
+            return result;
+        }
+
+        const unsigned int start_index = vertex_index(start);
+        if (start_index == NO_VERTEX) {
+            return result;
+        }
+
+        // BFS up to and including the level of the nearest destination, which holds every vertex of the DAG.
+        SearchWorkspace &search = workspace.search;
+        std::vector<unsigned int> &order = workspace.order;
+        std::vector<Distance> &distance = search.distance;
+        search.reset();
+        search.visit(start_index, start_index);
+        search.frontier.push_back(start_index);
+        distance[start_index] = 0;
+        order.assign(1, start_index);
+        bool found = false;
+        bfs_levels(search, [&](const unsigned int &vertex) {
+            distance[vertex] = distance[search.prev[vertex]] + 1;
+            order.push_back(vertex);
+            found = found || destinations.vertices[vertex];
+            return found;
+        }, MAX_DISTANCE);
+        if (!found) {
+            return result;
+        }
+        result.hops = distance[order.back()];
+
+        // Paths from the source add up in BFS order over the predecessors one level up, and paths to a
+        //  destination add up in reverse order over the successors one level down.
+        std::vector<double> &from_source = workspace.paths_from_source;
+        std::vector<double> &to_destination = workspace.paths_to_destination;
+        from_source[start_index] = 1;
+        for (size_t k = 1; k < order.size(); ++k) {
+            const unsigned int vertex = order[k];
+            from_source[vertex] = 0;
+            for (size_t j = offsets[vertex]; j < offsets[vertex + 1]; ++j) {
+                const unsigned int neighbor = neighbors[j];
+                if (search.visited(neighbor) && distance[neighbor] == distance[vertex] - 1) {
+                    from_source[vertex] += from_source[neighbor];
+                }
+            }
+        }
+        for (size_t k = order.size(); k-- > 0;) {
+            const unsigned int vertex = order[k];
+            to_destination[vertex] = distance[vertex] == result.hops && destinations.vertices[vertex] ? 1 : 0;
+            if (distance[vertex] == result.hops) {
+                continue;
+            }
+            for (size_t j = offsets[vertex]; j < offsets[vertex + 1]; ++j) {
+                const unsigned int neighbor = neighbors[j];
+                if (search.visited(neighbor) && distance[neighbor] == distance[vertex] + 1) {
+                    to_destination[vertex] += to_destination[neighbor];
+                }
+            }
+        }
+
+        result.path_count = to_destination[start_index];
+        for (const auto &vertex : order) {
+            if (to_destination[vertex] > 0) {
+                result.vertex_fractions[vertex_ips[vertex]] = from_source[vertex] * to_destination[vertex] / result.path_count;
+            }
+        }
+
+        // Path r in lexicographic order is found by descending into the successor whose range of path numbers
+        //  holds r, so sampling evenly spaced numbers gives a stratified sample without enumerating the paths.
+        const double sample_size = std::min(static_cast<double>(max_paths), result.path_count);
+        for (size_t s = 0; s < sample_size; ++s) {
+            double rank = std::floor((s + 0.5) * result.path_count / sample_size);
+            std::vector<unsigned int> path(1, start);
+            unsigned int current_node = start_index;
+            while (distance[current_node] < result.hops) {
+                const std::vector<unsigned int> successors = ecmp_successors(workspace, current_node);
+                unsigned int next = successors.back();
+                for (const auto &successor : successors) {
+                    if (rank < to_destination[successor]) {
+                        next = successor;
+                        break;
+                    }
+                    rank -= to_destination[successor];
+                }
+                current_node = next;
+                path.push_back(vertex_ips[current_node]);
+            }
+            result.paths.push_back(path);
+        }
+        return result;
+    }
+
+    // The successors of vertex in the shortest-path DAG that lead to a destination, in ascending order.
+    //  Requires workspace.paths_to_destination for the next level.
+    std::vector<unsigned int> ecmp_successors(const ECMPWorkspace &workspace, const unsigned int &vertex) const {
+        std::vector<unsigned int> successors;
+        for (size_t j = offsets[vertex]; j < offsets[vertex + 1]; ++j) {
+            const unsigned int neighbor = neighbors[j];
+            if (workspace.search.visited(neighbor) && workspace.search.distance[neighbor] == workspace.search.distance[vertex] + 1
+                && workspace.paths_to_destination[neighbor] > 0) {
+                successors.push_back(neighbor);
+            }
+        }
+        return successors;
+    }
+
+    // Grows a BFS forest from the roots in workspace.frontier (each visited as its own parent) one level at a time,
+    //  recording the lowest-index parent of every vertex in workspace.prev. on_discover(vertex) is called once per
+    //  newly visited vertex, in ascending order within a level, and returning true stops the search after the
+    //  current level. The search also stops after max_hops levels, unless it is 0.
+    //  The search is direction-optimizing: small frontiers are expanded top-down, and once the frontier's edges
+    //  outnumber a fraction of the unexplored edges, each unvisited vertex instead checks whether any neighbor is
+    //  in the frontier bitmap (bottom-up), stopping at its first hit. Neighbors are sorted, so the first hit is the
+    //  lowest-index parent and both directions produce the same forest.
+    template <typename OnDiscover>
+    void bfs_levels(SearchWorkspace &workspace, OnDiscover on_discover, const size_t max_hops = 0) const {
+        std::vector<unsigned int> &frontier = workspace.frontier;
+        std::vector<unsigned int> &next_frontier = workspace.next_frontier;
+        std::vector<uint64_t> &frontier_bitmap = workspace.frontier_bitmap;
+        bool done = false;
+        bool bottom_up = false;
+        std::sort(frontier.begin(), frontier.end());
+
+        size_t unexplored_edges = neighbors.size();
+        for (const auto &vertex : frontier) {
+            unexplored_edges -= degree(vertex);
+        }
+
+        for (size_t level = 0; !frontier.empty() && !done && (max_hops == 0 || level < max_hops); ++level) {
+            if (!bottom_up && frontier_edges(frontier) > unexplored_edges / BOTTOM_UP_ALPHA) {
+                bottom_up = true;
+            } else if (bottom_up && frontier.size() < vertex_ips.size() / BOTTOM_UP_BETA) {
+                bottom_up = false;
+            }
+
+            next_frontier.clear();
+            if (bottom_up) {
+                for (const auto &vertex : frontier) {
+                    frontier_bitmap[vertex / 64] |= uint64_t(1) << (vertex % 64);
+                }
+                for (unsigned int vertex = 0; vertex < vertex_ips.size(); ++vertex) {
+                    if (workspace.visited(vertex)) {
+                        continue;
+                    }
+                    for (size_t j = offsets[vertex]; j < offsets[vertex + 1]; ++j) {
+                        const unsigned int neighbor = neighbors[j];
+                        if ((frontier_bitmap[neighbor / 64] >> (neighbor % 64)) & 1) {
+                            workspace.visit(vertex, neighbor);
+                            next_frontier.push_back(vertex);
+                            if (on_discover(vertex)) {
+                                done = true;
+                            }
+                            break;
+                        }
+                    }
+                }
+                for (const auto &vertex : frontier) {
+                    frontier_bitmap[vertex / 64] = 0;
+                }
+            } else {
+                for (const auto &current_node : frontier) {
+                    for (size_t j = offsets[current_node]; j < offsets[current_node + 1]; ++j) {
+                        const unsigned int neighbor = neighbors[j];
+                        if (workspace.visited(neighbor)) {
+                            continue;
+                        }
+                        workspace.visit(neighbor, current_node);
+                        next_frontier.push_back(neighbor);
+                    }
+                }
+                std::sort(next_frontier.begin(), next_frontier.end());
+                for (const auto &vertex : next_frontier) {
+                    if (on_discover(vertex)) {
+                        done = true;
+                    }
+                }
+            }
+
+            for (const auto &vertex : next_frontier) {
+                unexplored_edges -= degree(vertex);
+            }
+            frontier.swap(next_frontier);
+        }
+    }
+
+    std::vector<unsigned int> bidirectional_bfs(BidirectionalWorkspace &workspace, const unsigned int &start, const Endpoints &destinations, const size_t max_hops = 0) const {
+        if (destinations.has_ip(start)) {
+            return {start};
+        }
+
+        const unsigned int start_index = vertex_index(start);
+        if (start_index == NO_VERTEX) {
+            return {};
+        }
+        return to_ips(bidirectional_bfs_by_index(workspace, start_index, destinations.indices, max_hops));
+    }
+
+    // Alternates level expansions between the forward search from `start` and the backward search from all
+    //  destinations, always expanding the side whose frontier has fewer edges to scan. The first level in which a
+    //  vertex is visited by both sides yields a shortest path; among those meeting vertices the lowest index wins,
+    //  and the path is stitched from the forward parents up to it and the backward parents beyond it. Each expansion
+    //  adds one hop to the paths it can find, so the search stops after max_hops expansions (unless it is 0).
+    std::vector<unsigned int> bidirectional_bfs_by_index(BidirectionalWorkspace &workspace, const unsigned int &start, const std::vector<unsigned int> &destination_indices,
+                                                         const size_t max_hops = 0) const {
+        SearchWorkspace &forward = workspace.forward;
+        SearchWorkspace &backward = workspace.backward;
+        forward.reset();
+        backward.reset();
+        forward.visit(start, start);
+        forward.frontier.push_back(start);
+        for (const auto &vertex : destination_indices) {
+            backward.visit(vertex, vertex);
+            backward.frontier.push_back(vertex);
+        }
+
+        unsigned int meeting = NO_VERTEX;
+        for (size_t hops = 0; !forward.frontier.empty() && !backward.frontier.empty() && meeting == NO_VERTEX && (max_hops == 0 || hops < max_hops); ++hops) {
+            const bool expand_forward = frontier_edges(forward.frontier) <= frontier_edges(backward.frontier);
+            SearchWorkspace &side = expand_forward ? forward : backward;
+            const SearchWorkspace &other_side = expand_forward ? backward : forward;
 
-            for (const auto &neighbor : graph[current_node]) {
-                int_fast8_t distance = distances[current_node] + 1;
-                if (distance < distances[neighbor]) {
-                    distances[neighbor] = distance;
-                    min_heap.push(std::make_tuple(distance, neighbor));
-                    prev[neighbor] = current_node;
+            side.next_frontier.clear();
+            for (const auto &current_node : side.frontier) {
+                for (size_t j = offsets[current_node]; j < offsets[current_node + 1]; ++j) {
+                    const unsigned int neighbor = neighbors[j];
+                    if (side.visited(neighbor)) {
+                        continue;
+                    }
+                    side.visit(neighbor, current_node);
+                    side.next_frontier.push_back(neighbor);
+                    if (other_side.visited(neighbor) && neighbor < meeting) {
+                        meeting = neighbor;
+                    }
                 }
             }
+            side.frontier.swap(side.next_frontier);
         }
 
-        if (prev.find(current_node) == prev.end()) {
+        if (meeting == NO_VERTEX) {
             return {};
         }
 
         std::vector<unsigned int> path;
-        while (current_node != start) {
+        for (unsigned int current_node = meeting; current_node != start; current_node = forward.prev[current_node]) {
             path.push_back(current_node);
-            current_node = prev[current_node];
         }
         path.push_back(start);
         std::reverse(path.begin(), path.end());
+        for (unsigned int current_node = meeting; backward.prev[current_node] != current_node; ) {
+            current_node = backward.prev[current_node];
+            path.push_back(current_node);
+        }
         return path;
     }
+
+    size_t frontier_edges(const std::vector<unsigned int> &frontier) const {
+        size_t edges = 0;
+        for (const auto &vertex : frontier) {
+            edges += degree(vertex);
+        }
+        return edges;
+    }
+
+    size_t degree(const unsigned int &vertex) const {
+        return offsets[vertex + 1] - offsets[vertex];
+    }
+
+    template <size_t W>
+    std::vector<std::vector<unsigned int>> parallel_msbfs(const std::vector<unsigned int>& src_ips, const std::set<unsigned int>& destinations, const size_t max_hops) const {
+        const QueryScope query(*this);
+        const VertexSet is_destination = endpoints(destinations).vertices;
+
+        std::vector<std::vector<unsigned int>> results(src_ips.size());
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < src_ips.size(); ++i) {
+            if (destinations.find(src_ips[i]) != destinations.end()) {
+                results[i] = {src_ips[i]};
+            } else if (vertex_index(src_ips[i]) != NO_VERTEX) {
+                pending.push_back(i);
+            }
+        }
+
+        const size_t batch_size = W * 64;
+        const size_t batch_count = (pending.size() + batch_size - 1) / batch_size;
+        std::atomic<size_t> completed(src_ips.size() - pending.size());
+        parallel_items<MultiSourceWorkspace<W>>(batch_count, [&](const Graph &graph, MultiSourceWorkspace<W> &workspace, const size_t batch) {
+            const size_t begin = batch * batch_size;
+            const size_t end = std::min(begin + batch_size, pending.size());
+            std::vector<unsigned int> sources;
+            for (size_t k = begin; k < end; ++k) {
+                sources.push_back(vertex_index(src_ips[pending[k]]));
+            }
+
+            auto paths = graph.msbfs_batch_by_index<W>(workspace, sources, is_destination, max_hops);
+            for (size_t k = begin; k < end; ++k) {
+                results[pending[k]] = to_ips(paths[k - begin]);
+            }
+            report_progress(completed += end - begin, src_ips.size());
+        });
+        return results;
+    }
+
+    // Multi-source BFS (MS-BFS) for up to W * 64 sources at once. Bit i of seen[v] is set once sources[i] has reached
+    //  vertex v, and frontiers carry the bits that arrived at each vertex in the last level, so a vertex reached by
+    //  many sources at the same level is expanded once for all of them. A source stops at the first level containing
+    //  a destination. The bits that arrive at each level are logged, which gives dist(source, v) == level for path
+    //  reconstruction, and the parents and destinations picked are the same as bfs_by_index(). Sources that have
+    //  not found a destination within max_hops levels (unless it is 0) give up with an empty path.
+    template <size_t W>
+    std::vector<std::vector<unsigned int>> msbfs_batch_by_index(MultiSourceWorkspace<W> &workspace, const std::vector<unsigned int> &sources, const VertexSet &is_destination,
+                                                                const size_t max_hops = 0) const {
+        std::vector<SourceMask<W>> &seen = workspace.seen;
+        std::vector<SourceMask<W>> &next = workspace.next;
+        const size_t count = sources.size();
+        std::vector<unsigned int> found(count, NO_VERTEX);
+        std::vector<size_t> found_level(count, 0);
+
+        // Per level, the vertices reached in that level (ascending) and the source bits that arrived with them.
+        std::vector<std::vector<unsigned int>> level_vertices;
+        std::vector<std::vector<SourceMask<W>>> level_masks;
+
+        SourceMask<W> active;
+        active.clear();
+        std::vector<unsigned int> touched;
+        for (size_t i = 0; i < count; ++i) {
+            if (!next[sources[i]].any()) {
+                touched.push_back(sources[i]);
+            }
+            next[sources[i]].set(i);
+            active.set(i);
+        }
+
+        std::vector<std::pair<unsigned int, SourceMask<W>>> frontier;
+        while (!touched.empty()) {
+            // Commit the bits that arrived in this level.
+            const size_t level = level_vertices.size();
+            std::sort(touched.begin(), touched.end());
+            level_vertices.push_back(touched);
+            level_masks.emplace_back();
+            level_masks.back().reserve(touched.size());
+            for (const auto &vertex : touched) {
+                const SourceMask<W> arrived = next[vertex];
+                next[vertex].clear();
+                seen[vertex] |= arrived;
+                level_masks.back().push_back(arrived);
+                if (level == 0 || !is_destination[vertex]) {
+                    continue;
+                }
+                for (size_t w = 0; w < W; ++w) {
+                    for (uint64_t bits = arrived.words[w]; bits != 0; bits &= bits - 1) {
+                        const size_t source = w * 64 + __builtin_ctzll(bits);
+                        if (found[source] == NO_VERTEX) {
+                            found[source] = vertex;
+                            found_level[source] = level;
+                        }
+                    }
+                }
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (found[i] != NO_VERTEX) {
+                    active.reset(i);
+                }
+            }
+            if (!active.any() || (max_hops != 0 && level == max_hops)) {
+                break;
+            }
+
+            frontier.clear();
+            for (size_t k = 0; k < touched.size(); ++k) {
+                const SourceMask<W> expanding = level_masks.back()[k] & active;
+                if (expanding.any()) {
+                    frontier.push_back(std::make_pair(touched[k], expanding));
+                }
+            }
+
+            // Expand the frontier by one level.
+            touched.clear();
+            for (const auto &entry : frontier) {
+                for (size_t j = offsets[entry.first]; j < offsets[entry.first + 1]; ++j) {
+                    const unsigned int neighbor = neighbors[j];
+                    const SourceMask<W> arriving = entry.second.and_not(seen[neighbor]);
+                    if (!arriving.any()) {
+                        continue;
+                    }
+                    if (!next[neighbor].any()) {
+                        touched.push_back(neighbor);
+                    }
+                    next[neighbor] |= arriving;
+                }
+            }
+        }
+
+        // Walk back from each destination through the lowest-index neighbor that the source reached one level earlier.
+        std::vector<std::vector<unsigned int>> paths(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (found[i] == NO_VERTEX) {
+                continue;
+            }
+            std::vector<unsigned int> &path = paths[i];
+            unsigned int current_node = found[i];
+            path.push_back(current_node);
+            for (size_t level = found_level[i]; level > 0; --level) {
+                const std::vector<unsigned int> &vertices = level_vertices[level - 1];
+                for (size_t j = offsets[current_node]; j < offsets[current_node + 1]; ++j) {
+                    const unsigned int neighbor = neighbors[j];
+                    auto it = std::lower_bound(vertices.begin(), vertices.end(), neighbor);
+                    if (it != vertices.end() && *it == neighbor && level_masks[level - 1][it - vertices.begin()].test(i)) {
+                        current_node = neighbor;
+                        break;
+                    }
+                }
+                path.push_back(current_node);
+            }
+            std::reverse(path.begin(), path.end());
+        }
+
+        for (const auto &vertices : level_vertices) {
+            for (const auto &vertex : vertices) {
+                seen[vertex].clear();
+            }
+        }
+        return paths;
+    }
+
+private:
+    // Adjacency list filled by add_edge(), released by freeze().
+    std::unordered_map<unsigned int, std::unordered_set<unsigned int>> graph;
+
+    // Compressed-sparse-row (CSR) layout built by freeze(). Vertex i has IP vertex_ips[i] (sorted ascending),
+    //  and its neighbors are the vertex indices neighbors[offsets[i]] ... neighbors[offsets[i + 1] - 1].
+    FrozenArray<unsigned int> vertex_ips;
+    FrozenArray<size_t> offsets;
+    FrozenArray<unsigned int> neighbors;
+
+    // Locations filled by set_coordinates(), turned by freeze() into a unit-sphere position per vertex (3
+    //  coordinates each) and a great-circle weight in km per entry of neighbors. Empty without coordinates.
+    std::unordered_map<unsigned int, std::pair<double, double>> coordinates;
+    FrozenArray<double> positions;
+    FrozenArray<float> weights;
+
+    // Contraction hierarchy built by build_contraction_hierarchy(): the contraction rank of every vertex, and its
+    //  edges to higher-ranked vertices, sorted by target, in CSR layout. Empty until built or loaded.
+    FrozenArray<unsigned int> hierarchy_rank;
+    FrozenArray<size_t> hierarchy_offsets;
+    FrozenArray<ShortcutEdge> hierarchy_edges;
+
+    // Distance oracle built by build_distance_oracle(): the label of vertex i is the (landmark rank, hops) pairs
+    //  oracle_landmarks/oracle_distances[oracle_offsets[i]] ... [oracle_offsets[i + 1] - 1], by ascending rank.
+    FrozenArray<size_t> oracle_offsets;
+    FrozenArray<unsigned int> oracle_landmarks;
+    FrozenArray<Distance> oracle_distances;
+
+    // Whether the vertices are ITDK node numbers rather than IPs, see add_node_links().
+    bool node_level;
+
+    // The snapshot file that the arrays above view, when the graph was loaded with load().
+    std::unique_ptr<MappedFile> snapshot;
+
+    // With replicate_numa(), one graph per NUMA node with its own CSR, viewing the other arrays of this one, and
+    //  the CPUs of each node.
+    std::vector<std::unique_ptr<Graph>> numa_replicas;
+    std::vector<std::vector<int>> numa_cpus;
+
+    // Per-thread search state reused across queries, see parallel_items().
+    mutable WorkspacePool workspace_pool;
+
+    // The queries in progress and whether an update is, see QueryScope and UpdateScope.
+    mutable std::mutex update_mutex;
+    mutable size_t running_queries;
+    bool updating;
+    std::atomic<bool> frozen;
 };
 
+// Definitions of the constants that are bound to references, e.g. by std::vector's fill constructor.
+const unsigned int Graph::NO_VERTEX;
+const size_t Graph::MAX_DISTANCE;
+constexpr double Graph::EARTH_RADIUS_KM;
+constexpr double Graph::HEURISTIC_SCALE;
+const size_t Graph::WITNESS_SETTLE_LIMIT;
+const uint64_t Graph::HIERARCHY_FILE_MAGIC;
+const uint32_t Graph::HIERARCHY_FILE_VERSION;
+const uint64_t Graph::ORACLE_FILE_MAGIC;
+const uint32_t Graph::ORACLE_FILE_VERSION;
+const uint64_t Graph::SNAPSHOT_FILE_MAGIC;
+const uint32_t Graph::SNAPSHOT_FILE_VERSION;
+const size_t Graph::SNAPSHOT_ALIGNMENT;
+
 PYBIND11_MODULE(graph_module, m) {
+    py::class_<ECMPPaths>(m, "ECMPPaths")
+        .def_readonly("hops", &ECMPPaths::hops)
+        .def_readonly("path_count", &ECMPPaths::path_count)
+        .def_readonly("vertex_fractions", &ECMPPaths::vertex_fractions)
+        .def_readonly("paths", &ECMPPaths::paths);
+
+    py::class_<NodeIPs>(m, "NodeIPs")
+        .def_static("load", &NodeIPs::load, py::call_guard<py::gil_scoped_release>())
+        .def("keep_nodes", &NodeIPs::keep_nodes, py::call_guard<py::gil_scoped_release>())
+        .def("node_count", &NodeIPs::node_count)
+        .def("ip_count", &NodeIPs::ip_count)
+        .def("ips_of", &NodeIPs::ips_of)
+        .def("node_of", &NodeIPs::node_of)
+        .def("nodes_of", &NodeIPs::nodes_of)
+        .def("first_ips", &NodeIPs::first_ips)
+        .def_property_readonly("offsets", [](const py::object &self) { return numpy_view(self.cast<const NodeIPs &>().offsets, self); })
+        .def_property_readonly("ips", [](const py::object &self) { return numpy_view(self.cast<const NodeIPs &>().ips, self); })
+        .def_property_readonly("sorted_ips", [](const py::object &self) { return numpy_view(self.cast<const NodeIPs &>().sorted_ips, self); })
+        .def_property_readonly("ip_nodes", [](const py::object &self) { return numpy_view(self.cast<const NodeIPs &>().ip_nodes, self); });
+
     py::class_<Graph>(m, "Graph")
         .def(py::init<>())
         .def("reserve", &Graph::reserve)
         .def("add_edge", &Graph::add_edge)
-        .def("parallelDijkstra", &Graph::parallelDijkstra);
+        .def("add_links", static_cast<size_t (Graph::*)(const std::string &, const std::unordered_map<std::string, std::vector<std::string>> &)>(&Graph::add_links),
+             py::call_guard<py::gil_scoped_release>())
+        .def("add_links", static_cast<size_t (Graph::*)(const std::string &, const NodeIPs &)>(&Graph::add_links), py::call_guard<py::gil_scoped_release>())
+        .def("add_node_links", &Graph::add_node_links, py::call_guard<py::gil_scoped_release>())
+        .def("is_node_level", &Graph::is_node_level)
+        .def("set_node_coordinates", &Graph::set_node_coordinates)
+        .def("set_coordinates", &Graph::set_coordinates)
+        .def("freeze", &Graph::freeze)
+        .def("vertex_count", &Graph::vertex_count)
+        .def("replicate_per_numa_node", &Graph::replicate_per_numa_node)
+        .def("save", &Graph::save, py::call_guard<py::gil_scoped_release>())
+        .def_static("load", &Graph::load, py::arg("path"), py::arg("verify") = true, py::call_guard<py::gil_scoped_release>())
+        .def("publish", &Graph::publish, py::call_guard<py::gil_scoped_release>())
+        .def_static("attach", &Graph::attach, py::arg("name"), py::arg("verify") = false, py::call_guard<py::gil_scoped_release>())
+        .def_static("is_published", &Graph::is_published)
+        .def_static("unpublish", &Graph::unpublish)
+        .def("build_distance_oracle", &Graph::build_distance_oracle, py::call_guard<py::gil_scoped_release>())
+        .def("has_distance_oracle", &Graph::has_distance_oracle)
+        .def("save_distance_oracle", &Graph::save_distance_oracle, py::call_guard<py::gil_scoped_release>())
+        .def("load_distance_oracle", &Graph::load_distance_oracle, py::call_guard<py::gil_scoped_release>())
+        .def("hop_distance", &Graph::hop_distance)
+        .def("oracle_path", &Graph::oracle_path)
+        .def("parallelHopDistances", &Graph::parallelHopDistances, py::call_guard<py::gil_scoped_release>())
+        .def("build_contraction_hierarchy", &Graph::build_contraction_hierarchy, py::call_guard<py::gil_scoped_release>())
+        .def("has_contraction_hierarchy", &Graph::has_contraction_hierarchy)
+        .def("save_contraction_hierarchy", &Graph::save_contraction_hierarchy, py::call_guard<py::gil_scoped_release>())
+        .def("load_contraction_hierarchy", &Graph::load_contraction_hierarchy, py::call_guard<py::gil_scoped_release>())
+        .def("parallelDijkstra", &Graph::parallelDijkstra, py::arg("src_ips"), py::arg("destinations"), py::arg("max_hops") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def("parallelBFS", &Graph::parallelBFS, py::arg("src_ips"), py::arg("destinations"), py::arg("max_hops") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def("parallelRadius", &Graph::parallelRadius, py::arg("src_ips"), py::arg("radius"), py::call_guard<py::gil_scoped_release>())
+        .def("parallelAStar", &Graph::parallelAStar, py::call_guard<py::gil_scoped_release>())
+        .def("parallelCHSearch", &Graph::parallelCHSearch, py::call_guard<py::gil_scoped_release>())
+        .def("parallelECMP", &Graph::parallelECMP, py::arg("src_ips"), py::arg("destinations"), py::arg("max_paths") = 16,
+             py::call_guard<py::gil_scoped_release>())
+        .def("parallelKShortestPaths", &Graph::parallelKShortestPaths, py::arg("src_ips"), py::arg("destinations"), py::arg("k"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("reverseBFS", &Graph::reverseBFS, py::arg("src_ips"), py::arg("destinations"), py::arg("max_hops") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def("parallelBidirectionalBFS", &Graph::parallelBidirectionalBFS, py::arg("src_ips"), py::arg("destinations"), py::arg("max_hops") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def("parallelGroupPairs", &Graph::parallelGroupPairs, py::arg("src_groups"), py::arg("dst_groups"), py::arg("algorithm") = "reverse-bfs",
+             py::arg("max_hops") = 0, py::call_guard<py::gil_scoped_release>())
+        .def("parallelMultiTargetBFS", &Graph::parallelMultiTargetBFS, py::arg("src_ips"), py::arg("dst_groups"), py::arg("max_hops") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def("multiTargetVisitedCount", &Graph::multiTargetVisitedCount, py::arg("src_ip"), py::arg("dst_groups"), py::arg("max_hops") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def("parallelMSBFS", &Graph::parallelMSBFS, py::arg("src_ips"), py::arg("destinations"), py::arg("batch_size") = 64,
+             py::arg("max_hops") = 0, py::call_guard<py::gil_scoped_release>());
 }
@@ -4,10 +4,12 @@ import argparse
 import logging
 import pandas as pd
 
-from common import get_routes_from_file, init_logging, load_itdk_node_ip_to_id_mapping
+from common import find_itdk_file, get_routes_from_file, init_logging, load_itdk_node_ip_to_id_mapping
 
 def parse_node_asn_as_dataframe(node_as_filename='../data/caida-itdk/midar-iff.nodes.as') -> pd.Series:
     """Parse the node AS file and return a series of AS numbers with the node ID as the index."""
+    # pandas decompresses .bz2/.gz release files by their extension
+    node_as_filename = find_itdk_file(node_as_filename)
     logging.info(f'Loading node geo entries from {node_as_filename} ...')
     columns = ['label', 'node_id', 'AS', 'heuristic_tag']
     column_dtypes = {
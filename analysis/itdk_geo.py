@@ -12,10 +12,12 @@ from typing import Callable, Optional
 import numpy as np
 import pandas as pd
 
-from common import Coordinate, RouteInCoordinate, RouteInIP, detect_cloud_regions_from_filename, get_routes_from_file, init_logging, load_itdk_node_ip_to_id_mapping, remove_duplicate_consecutive_hops
+from common import Coordinate, RouteInCoordinate, RouteInIP, detect_cloud_regions_from_filename, find_itdk_file, get_routes_from_file, init_logging, load_itdk_node_ip_to_id_mapping, remove_duplicate_consecutive_hops
 from carbon_client import get_carbon_region_from_coordinate
 
 def parse_node_geo_as_dataframe(node_geo_filename='../data/caida-itdk/midar-iff.nodes.geo') -> pd.DataFrame:
+    # pandas decompresses .bz2/.gz release files by their extension
+    node_geo_filename = find_itdk_file(node_geo_filename)
     logging.info(f'Loading node geo entries from {node_geo_filename} ...')
     columns = ['node_id', 'continent', 'country', 'region', 'city', 'lat', 'long', 'pop', 'IX', 'source']
     column_dtypes = {
@@ -2,15 +2,15 @@
 
 import argparse
 import ast
-import itertools
+import hashlib
 import logging
-import re
-import sys
+import os
 import time
 
-from common import MATCHED_NODES_FILENAME_AWS, MATCHED_NODES_FILENAME_GCLOUD, init_logging, load_itdk_node_id_to_ips_mapping
-from itdk_geo import get_node_ids_with_geo_coordinates
-from graph_module import Graph
+from common import MATCHED_NODES_FILENAME_AWS, MATCHED_NODES_FILENAME_GCLOUD, find_itdk_file, init_logging, load_itdk_nodes
+from itdk_geo import get_node_ids_with_geo_coordinates, parse_node_geo_as_dataframe
+from graph_module import Graph, NodeIPs
+import pandas as pd
 
 import socket
 import struct
@@ -23,55 +23,37 @@ def unsigned_int_to_ip(unsigned_int: int) -> str:
     packed_ip = struct.pack("!I", unsigned_int)
     return socket.inet_ntoa(packed_ip)
 
-def load_itdk_graph_from_links(itdk_node_id_to_ips: dict[str, list], link_file='../data/caida-itdk/midar-iff.links') -> Graph:
+def load_itdk_graph_from_links(itdk_nodes: NodeIPs, link_file='../data/caida-itdk/midar-iff.links',
+                               node_geo_df: pd.DataFrame = None, node_level=False) -> Graph:
     logging.info('Building graph from ITDK nodes/links ...')
 
-    logging.info('Loading links from file to memory ...')
+    graph = Graph()
+    graph.reserve(itdk_nodes.node_count() if node_level else itdk_nodes.ip_count())
+
+    # Links are parsed natively on all cores, adding an edge between every two known IPs of the nodes on each link.
+    #   Nxxx:1.2.3.4 is a known interface and Nxxxx an inferred one; there are no links between known interfaces
+    #   only, and geo information is tied to node IDs, so all IPs of each node are used.
+    #   More detail: https://publicdata.caida.org/datasets/topology/ark/ipv4/itdk/2022-02/ under .links
+    #   With node_level, the vertices are the nodes instead and each link adds an edge between every two of its
+    #   nodes, so that routes are between routers and do not hop among the interfaces of the same router.
+    logging.info('Building adjacency list graph in memory ...')
     start_time = time.time()
-    with open(link_file) as file:
-        all_lines = file.readlines()
+    if node_level:
+        edge_count = graph.add_node_links(find_itdk_file(link_file), itdk_nodes)
+    else:
+        edge_count = graph.add_links(find_itdk_file(link_file), itdk_nodes)
     elapsed_time = time.time() - start_time
-    logging.info(f'Elapsed: {elapsed_time}s, read {len(all_lines)} lines.')
+    logging.info(f'Elapsed: {elapsed_time:.2f}s, total edge count: {edge_count}')
 
-    graph = Graph()
-    graph.reserve(len(itdk_node_id_to_ips))
-    edge_count = 0
-    re_link = re.compile(r'^link L(?:\d+): +([N\d.: ]+)')
+    if node_geo_df is not None:
+        logging.info('Setting router coordinates for geodesic edge weights ...')
+        graph.set_node_coordinates(itdk_nodes, node_geo_df.index.tolist(), node_geo_df['lat'].tolist(), node_geo_df['long'].tolist())
 
-    logging.info('Building adjacency list graph in memory ...')
+    logging.info('Freezing graph into CSR layout ...')
     start_time = time.time()
-    for line in all_lines:
-        if line.startswith('#'):
-            continue
-
-        m = re_link.match(line)
-        if not m:
-            print('Cannot process line:', line, file=sys.stderr)
-            continue
-        routers = m.group(1)
-        known_interfaces = set()
-        for router in routers.split():
-            # router is either Nxxx:1.2.3.4 (known interface) or Nxxxx (inferred interface).
-            # There's no links at IP level from known interface only, using inferred interface.
-            #   More detail: https://publicdata.caida.org/datasets/topology/ark/ipv4/itdk/2022-02/ under .links
-            # Because geo information is only tied to node ID, we need to use node ID to find the IP addresses.
-            node_id = router.split(':', 1)[0]
-            router_ips = itdk_node_id_to_ips.get(node_id, [])
-            for router_ip in router_ips:
-                known_interfaces.add(router_ip)
-        if len(known_interfaces) <= 1:
-            continue
-        # print(f'Found interfaces: {known_interfaces}', file=sys.stderr)
-        for (n1, n2) in itertools.combinations(known_interfaces, 2):
-            graph.add_edge(ip_to_unsigned_int(n1), ip_to_unsigned_int(n2))
-
-        edge_count += 1
-        if edge_count % 1000000 == 0:
-            elapsed_time = time.time() - start_time
-            logging.debug(f'Elapsed: {elapsed_time}s, edge count: {edge_count}')
-            # break   # _debug_
+    graph.freeze()
     elapsed_time = time.time() - start_time
-    logging.info(f'Elapsed: {elapsed_time:.2f}s, total edge count: {edge_count}')
+    logging.info(f'Elapsed: {elapsed_time:.2f}s, total vertex count: {graph.vertex_count()}')
     return graph
 
 def get_cloud_region_matched_ips(cloud: str, region: str) -> list[str]:
@@ -103,23 +85,14 @@ def get_cloud_region_matched_ips(cloud: str, region: str) -> list[str]:
     logging.info(f'Found {len(ips)} IPs for {cloud}:{region}.')
     return ips
 
-def remove_node_without_geo_coordinates(itdk_node_id_to_ips: dict):
-    nodes_with_geo_coordinates = set(get_node_ids_with_geo_coordinates())
-    removed_count = 0
-
+def remove_node_without_geo_coordinates(itdk_nodes: NodeIPs) -> NodeIPs:
     logging.info('Removing nodes without geocoordinates ...')
-    processed_count = 0
     start_time = time.time()
-    for node_id in itdk_node_id_to_ips.copy().keys():
-        if node_id not in nodes_with_geo_coordinates:
-            del itdk_node_id_to_ips[node_id]
-            removed_count += 1
-
-        processed_count += 1
-        if processed_count % 1000000 == 0:
-            elapsed_time = time.time() - start_time
-            logging.debug(f'Elapsed: {elapsed_time:.2f}s, node count: {processed_count}')
-    logging.info(f'Removed {removed_count} nodes without geocoordinates.')
+    nodes_with_geo_coordinates = itdk_nodes.keep_nodes(get_node_ids_with_geo_coordinates())
+    elapsed_time = time.time() - start_time
+    removed_count = itdk_nodes.ip_count() - nodes_with_geo_coordinates.ip_count()
+    logging.info(f'Elapsed: {elapsed_time:.2f}s, removed {removed_count} IPs of nodes without geocoordinates.')
+    return nodes_with_geo_coordinates
 
 def parse_args():
     parser = argparse.ArgumentParser()
@@ -134,6 +107,41 @@ def parse_args():
     parser.add_argument('--src-ips', required=False, nargs='+', help='The source IP addresses')
     parser.add_argument('--dst-ips', required=False, nargs='+', help='The destination IP addresses')
 
+    parser.add_argument('--algorithm', default='reverse-bfs', choices=[ 'reverse-bfs', 'msbfs', 'bidirectional', 'bfs', 'dijkstra', 'multi-target', 'astar', 'ch' ],
+                        help='The shortest path algorithm; all but astar and ch find routes with the fewest hops, of the same hop count. '
+                             'reverse-bfs runs a single search from the destinations for each region pair, '
+                             'msbfs finds the same routes as bfs with batches of sources sharing one search, '
+                             'bidirectional is the fastest for a few source IPs, '
+                             'multi-target finds the same routes as bfs with one search per source for all destination regions, '
+                             'astar finds the shortest routes in km between router locations instead of in hops, '
+                             'ch finds the same routes as astar from a contraction hierarchy, see --contraction-hierarchy')
+    parser.add_argument('--contraction-hierarchy', required=False,
+                        help='The contraction hierarchy file for --algorithm ch, built and saved if it does not exist '
+                             '(default: ../data/caida-itdk/midar-iff.ch, or midar-iff.node-level.ch with --node-level)')
+    parser.add_argument('--node-level', action='store_true',
+                        help='Build the graph with one vertex per ITDK node and an edge per pair of nodes on a link, '
+                             'instead of per pair of their interfaces; routes are printed with the first IP of each router')
+    parser.add_argument('--graph-snapshot', required=False,
+                        help='A graph snapshot file to map instead of parsing the ITDK files, saved after building the graph if it does not exist')
+    parser.add_argument('--shared-graph', required=False,
+                        help='Attach to the graph published under this name by another process on this host, '
+                             'or publish it there for others after building or loading it; the name is suffixed with a '
+                             'digest of the ITDK files and options the graph is built from, and the graph stays in memory '
+                             'until Graph.unpublish(), see --published-graphs-file')
+    parser.add_argument('--published-graphs-file', required=False,
+                        help='Append the full name of the shared graph to this file if this process publishes it, so that '
+                             'the caller can unpublish exactly the graphs it created')
+    parser.add_argument('--numa-replicas', action='store_true',
+                        help='Copy the graph to every NUMA node and pin the search threads to the node whose copy they read')
+    parser.add_argument('--msbfs-batch-size', type=int, default=64, choices=[ 64, 128, 256, 512 ],
+                        help='The number of sources per search with --algorithm msbfs')
+    parser.add_argument('--max-hops', type=int, default=0,
+                        help='Give up on sources with no destination within this many hops (0 for no limit)')
+    parser.add_argument('--ecmp-paths', type=int, default=0,
+                        help='Print up to this many of the equal-hop shortest paths from each source, instead of one')
+    parser.add_argument('--k-shortest', type=int, default=0,
+                        help='Print this many of the fewest-hop loopless paths from each source, instead of one')
+
     # Must provide one of src/dst cloud, ips or nodes
     args = parser.parse_args()
     if not (args.src_cloud or args.src_ips or args.src_nodes):
@@ -152,41 +160,140 @@ def load_ips_in_groups(cloud: str, regions: list[str], ips: list[str]) -> dict[s
     else:
         return {}
 
+def group_pairs(src_ips_groups: dict, dst_ips_groups: dict):
+    """Yield the (source group, destination group) pairs to route, with the same rules as Graph.parallelGroupPairs()."""
+    for src_group in src_ips_groups:
+        for dst_group in dst_ips_groups:
+            # Skip same region routes
+            if src_group and src_group == dst_group:
+                continue
+            yield src_group, dst_group
+
+def get_shared_graph_name(args) -> str:
+    """Qualify the --shared-graph name with the ITDK release and the options that change the graph, so that a job
+    never attaches to a graph published from other files or with other options."""
+    files = ['../data/caida-itdk/midar-iff.links', '../data/caida-itdk/midar-iff.nodes', '../data/caida-itdk/midar-iff.nodes.geo']
+    if args.graph_snapshot:
+        files.append(args.graph_snapshot)
+    key = [args.node_level, args.algorithm in [ 'astar', 'ch' ]]
+    for file in files:
+        file = find_itdk_file(file)
+        if os.path.exists(file):
+            status = os.stat(file)
+            key += [os.path.realpath(file), status.st_size, status.st_mtime_ns]
+    return f'{args.shared_graph}.{hashlib.sha1(repr(key).encode()).hexdigest()[:12]}'
+
 def main():
     init_logging()
     args = parse_args()
     src_ips_groups = load_ips_in_groups(args.src_cloud, args.src_regions, args.src_ips)
     dst_ips_groups = load_ips_in_groups(args.dst_cloud, args.dst_regions, args.dst_ips)
 
-    # Build graph from ITDK nodes/links
-    itdk_node_id_to_ips = load_itdk_node_id_to_ips_mapping()
-    remove_node_without_geo_coordinates(itdk_node_id_to_ips)
-    graph = load_itdk_graph_from_links(itdk_node_id_to_ips)
+    # Build graph from ITDK nodes/links, or map a snapshot or shared copy of it
+    itdk_nodes = None
+    if args.shared_graph:
+        args.shared_graph = get_shared_graph_name(args)
+    attach_shared_graph = args.shared_graph and Graph.is_published(args.shared_graph)
+    publish_shared_graph = args.shared_graph and not attach_shared_graph
+    save_snapshot = args.graph_snapshot and not os.path.exists(args.graph_snapshot) and not attach_shared_graph
+    if args.src_nodes or args.dst_nodes or args.node_level or not (args.graph_snapshot or attach_shared_graph) or save_snapshot:
+        itdk_nodes = remove_node_without_geo_coordinates(load_itdk_nodes())
+    if attach_shared_graph:
+        logging.info(f'Attaching to shared graph {args.shared_graph} ...')
+        graph = Graph.attach(args.shared_graph)
+        logging.info(f'Total vertex count: {graph.vertex_count()}')
+    elif args.graph_snapshot and not save_snapshot:
+        logging.info(f'Loading graph snapshot from {args.graph_snapshot} ...')
+        start_time = time.time()
+        graph = Graph.load(args.graph_snapshot)
+        elapsed_time = time.time() - start_time
+        logging.info(f'Elapsed: {elapsed_time:.2f}s, total vertex count: {graph.vertex_count()}')
+    else:
+        node_geo_df = parse_node_geo_as_dataframe() if args.algorithm in [ 'astar', 'ch' ] else None
+        graph = load_itdk_graph_from_links(itdk_nodes, node_geo_df=node_geo_df, node_level=args.node_level)
+    if graph.is_node_level() != args.node_level:
+        # A snapshot or shared graph keeps the level it was built with
+        level = 'node' if graph.is_node_level() else 'interface'
+        logging.warning(f'The graph was built {level}-level, regardless of --node-level')
+        if itdk_nodes is None:
+            itdk_nodes = remove_node_without_geo_coordinates(load_itdk_nodes())
+    if args.algorithm == 'ch' and not graph.has_contraction_hierarchy():
+        if not args.contraction_hierarchy:
+            args.contraction_hierarchy = '../data/caida-itdk/midar-iff.node-level.ch' if graph.is_node_level() else '../data/caida-itdk/midar-iff.ch'
+        start_time = time.time()
+        if os.path.exists(args.contraction_hierarchy):
+            logging.info(f'Loading contraction hierarchy from {args.contraction_hierarchy} ...')
+            graph.load_contraction_hierarchy(args.contraction_hierarchy)
+        else:
+            logging.info('Building contraction hierarchy ...')
+            graph.build_contraction_hierarchy()
+            graph.save_contraction_hierarchy(args.contraction_hierarchy)
+        save_snapshot = bool(args.graph_snapshot)
+        publish_shared_graph = bool(args.shared_graph)
+        elapsed_time = time.time() - start_time
+        logging.info(f'Elapsed: {elapsed_time:.2f}s')
+    if save_snapshot:
+        logging.info(f'Saving graph snapshot to {args.graph_snapshot} ...')
+        graph.save(args.graph_snapshot)
+    if publish_shared_graph:
+        # Re-attach so that this process also reads the shared copy and frees its own
+        logging.info(f'Publishing shared graph {args.shared_graph} ...')
+        graph.publish(args.shared_graph)
+        graph = Graph.attach(args.shared_graph)
+        if args.published_graphs_file:
+            with open(args.published_graphs_file, 'a') as file:
+                file.write(f'{args.shared_graph}\n')
+    if args.numa_replicas:
+        logging.info(f'Replicated the graph on {graph.replicate_per_numa_node()} NUMA nodes')
 
     # Load the set of source and destination IPs
     if not src_ips_groups:
-        src_ips_groups = { '': [ip for node_id in args.src_nodes for ip in itdk_node_id_to_ips[node_id]] }
+        src_ips_groups = { '': [unsigned_int_to_ip(ip) for node_id in args.src_nodes for ip in itdk_nodes.ips_of(node_id)] }
     if not dst_ips_groups:
-        dst_ips_groups = { '': [ip for node_id in args.dst_nodes for ip in itdk_node_id_to_ips[node_id]] }
+        dst_ips_groups = { '': [unsigned_int_to_ip(ip) for node_id in args.dst_nodes for ip in itdk_nodes.ips_of(node_id)] }
+
+    src_ips_groups = { group: [ip_to_unsigned_int(item) for item in ips] for group, ips in src_ips_groups.items() }
+    dst_ips_groups = { group: [ip_to_unsigned_int(item) for item in ips] for group, ips in dst_ips_groups.items() }
+    if graph.is_node_level():
+        # The vertices are the nodes of the IPs, and paths are printed with the first IP of each node
+        src_ips_groups = { group: itdk_nodes.nodes_of(ips) for group, ips in src_ips_groups.items() }
+        dst_ips_groups = { group: itdk_nodes.nodes_of(ips) for group, ips in dst_ips_groups.items() }
+
+    # Run shortest path search in parallel, for all region pairs at once
+    logging.info(f'Finding paths from {len(src_ips_groups)} source groups to {len(dst_ips_groups)} destination groups ...')
+    start_time = time.time()
+    if args.ecmp_paths > 0:
+        paths_by_group_pair = {}
+        for src_group, dst_group in group_pairs(src_ips_groups, dst_ips_groups):
+            ecmp_by_source = graph.parallelECMP(src_ips_groups[src_group], set(dst_ips_groups[dst_group]), args.ecmp_paths)
+            logging.info(f'{src_group} -> {dst_group}: {sum(ecmp.path_count for ecmp in ecmp_by_source):.0f} equal-hop paths in total')
+            paths_by_group_pair[(src_group, dst_group)] = [path for ecmp in ecmp_by_source for path in ecmp.paths]
+    elif args.k_shortest > 0:
+        paths_by_group_pair = {}
+        for src_group, dst_group in group_pairs(src_ips_groups, dst_ips_groups):
+            paths_by_source = graph.parallelKShortestPaths(src_ips_groups[src_group], set(dst_ips_groups[dst_group]), args.k_shortest)
+            paths_by_group_pair[(src_group, dst_group)] = [path for paths in paths_by_source for path in paths]
+    elif args.algorithm == 'msbfs':
+        paths_by_group_pair = {}
+        for src_group, dst_group in group_pairs(src_ips_groups, dst_ips_groups):
+            paths_by_group_pair[(src_group, dst_group)] = graph.parallelMSBFS(
+                src_ips_groups[src_group], set(dst_ips_groups[dst_group]), args.msbfs_batch_size, args.max_hops)
+    else:
+        paths_by_group_pair = graph.parallelGroupPairs(src_ips_groups, dst_ips_groups, args.algorithm, args.max_hops)
+    elapsed_time = time.time() - start_time
+    logging.info(f'Elapsed: {elapsed_time}s')
 
     for src_group in src_ips_groups:
         for dst_group in dst_ips_groups:
-            # Skip same region routes
-            if src_group and src_group == dst_group:
+            if (src_group, dst_group) not in paths_by_group_pair:
                 continue
 
-            src_ips = [ip_to_unsigned_int(item) for item in src_ips_groups[src_group]]
-            dst_ips = [ip_to_unsigned_int(item) for item in dst_ips_groups[dst_group]]
-
-            # Run Dijkstra in parallel
-            logging.info(f'Finding paths from {src_group} to {dst_group} ...')
-            logging.info(f'Source IP count: {len(src_ips)}, destination IP count: {len(dst_ips)}')
-            start_time = time.time()
-            paths = graph.parallelDijkstra(src_ips, set(dst_ips))
-            elapsed_time = time.time() - start_time
-            logging.info(f'Elapsed: {elapsed_time}s')
-
+            endpoint = 'node' if graph.is_node_level() else 'IP'
+            logging.info(f'Source {endpoint} count: {len(src_ips_groups[src_group])}, destination {endpoint} count: {len(dst_ips_groups[dst_group])}')
             print(f'# {src_group} -> {dst_group}')
+            paths = paths_by_group_pair[(src_group, dst_group)]
+            if graph.is_node_level():
+                paths = [itdk_nodes.first_ips(path) for path in paths]
             paths = [[unsigned_int_to_ip(item) for item in path] for path in paths if path]
             for path in paths:
                 print(path)
@@ -10,9 +10,28 @@ source ./run_all.shared.sh
 # export SRC_REGION="TBD"
 export HOSTNAME="$(hostname -s)"
 
+# The first job on each NUMA node publishes the graph for the others, and it stays in memory after they exit.
+#   itdk_links.py records the full names of the graphs it publishes, and only those are removed when this run is
+#   done, unless a process of another run of this script on the same host still maps them.
+export PUBLISHED_GRAPHS_FILE="$(mktemp)"
+
+unpublish_shared_graphs()
+{
+    for name in $(sort -u "$PUBLISHED_GRAPHS_FILE"); do
+        if grep -qsF "/dev/shm/$name" /proc/[0-9]*/maps; then
+            echo >&2 "Keeping shared graph $name, which another process still maps"
+            continue
+        fi
+        python3 -c 'import sys; from graph_module import Graph; Graph.unpublish(sys.argv[1])' "$name"
+    done
+    rm -f "$PUBLISHED_GRAPHS_FILE"
+}
+trap unpublish_shared_graphs EXIT
+
 # Note: Each call is meant to be run over multiple console windows and over multiple machines.
 #   Remove the tee redirects if you want to run them in the background and don't want to see output in console.
 #   Use other batch execution systems if you want to automatically run them on multiple machines.
+#   Alternatively, run one process per machine without numactl and pass --numa-replicas to itdk_links.py.
 
 run_single_src_region_to_entire_cloud()
 {
@@ -32,6 +51,7 @@ run_single_src_region_to_entire_cloud()
         /usr/bin/time -v \
         ./itdk_links.py --src-cloud $src_cloud --src-regions $src_region \
                         --dst-cloud $dst_cloud --dst-regions $(echo "$dst_regions") \
+                        --shared-graph itdk-links.numa$numanode --published-graphs-file "$PUBLISHED_GRAPHS_FILE" \
             1> >(tee $HOSTNAME.numa$numanode.routes.$src_cloud.$src_region.$dst_cloud.all.by_ip) \
             2> >(tee $HOSTNAME.numa$numanode.routes.$src_cloud.$src_region.$dst_cloud.all.err >&2)
 }
@@ -1,3 +1,4 @@
+import os
 from setuptools import setup, Extension
 import pybind11
 
@@ -9,8 +10,12 @@ setup(
             ['graph_helper.cpp'],
             include_dirs=[pybind11.get_include()],
             language='c++',
+            # Width of the per-thread hop counts: 8, 16 or 32 bits
+            define_macros=[('GRAPH_DISTANCE_BITS', os.environ.get('GRAPH_DISTANCE_BITS', '16'))],
             extra_compile_args=['-std=c++11', '-fopenmp'],
-            extra_link_args=['-fopenmp']
+            extra_link_args=['-fopenmp'],
+            # Compressed ITDK releases are read directly
+            libraries=['z', 'bz2']
         ),
     ],
     setup_requires=['pybind11'],
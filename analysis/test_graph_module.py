@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+# Run from this directory after building the module (see setup_pybind.sh): python3 -m unittest test_graph_module
+
+import unittest
+
+from graph_module import Graph
+
+class MultiTargetBFSTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        # A chain 1 - 2 - ... - 20, and a separate component 100 - 101.
+        cls.graph = Graph()
+        for ip in range(1, 20):
+            cls.graph.add_edge(ip, ip + 1)
+        cls.graph.add_edge(100, 101)
+        cls.graph.freeze()
+
+    def test_labels_not_in_graph_do_not_disable_early_exit(self):
+        reachable = { 'near': [3] }
+        dst_groups = dict(reachable, absent=[999], empty=[])
+        paths = self.graph.parallelMultiTargetBFS([1], dst_groups)
+        self.assertEqual(paths['near'], [[1, 2, 3]])
+        self.assertEqual(paths['absent'], [[]])
+        self.assertEqual(paths['empty'], [[]])
+
+        # The search stops at the level of 'near', as it does without the labels that are not in the graph.
+        self.assertEqual(self.graph.multiTargetVisitedCount(1, reachable), 3)
+        self.assertEqual(self.graph.multiTargetVisitedCount(1, dst_groups), 3)
+
+    def test_unreachable_label_exhausts_only_the_source_component(self):
+        dst_groups = { 'near': [3], 'other': [101] }
+        paths = self.graph.parallelMultiTargetBFS([1], dst_groups)
+        self.assertEqual(paths['near'], [[1, 2, 3]])
+        self.assertEqual(paths['other'], [[]])
+        self.assertEqual(self.graph.multiTargetVisitedCount(1, dst_groups), 20)
+
+if __name__ == '__main__':
+    unittest.main()